@@ -1,14 +1,12 @@
-#version 330 core
+#version 440 core
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
     sampler2D specular;    
     float shininess;
 }; 
 
 struct Light {
-    //vec3 position;
     vec3 direction;
 
     vec3 ambient;
@@ -19,25 +17,42 @@ struct Light {
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
+flat in uint MaterialIndex;
   
-uniform vec3 viewPos;
+// per-frame camera state, shared by every program through binding point 0
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+
+// per-scene lighting, shared by every program through binding point 1
+layout (std140) uniform PerScene
+{
+    Light light;
+};
+
 uniform Material material;
-uniform Light light;
+// diffuse texture of every material, one layer each, indexed by the draw's material
+uniform sampler2DArray diffuseMaps;
 
 void main()
 {
+    vec3 diffuseColor = texture(diffuseMaps, vec3(TexCoords, MaterialIndex)).rgb;
+
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
+    vec3 ambient = light.ambient * diffuseColor;
   	
     // diffuse 
     vec3 norm = normalize(Normal);
     // vec3 lightDir = normalize(light.position - FragPos);
     vec3 lightDir = normalize(-light.direction);  
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;  
+    vec3 diffuse = light.diffuse * diff * diffuseColor;  
     
     // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     vec3 specular = light.specular * spec * texture(material.specular, TexCoords).rgb;  
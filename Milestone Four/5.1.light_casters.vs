@@ -1,21 +1,32 @@
-#version 330 core
+#version 440 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in uint aMaterialIndex;    // per-instance, selected through baseInstance
+layout (location = 6) in mat4 aInstanceTransform;   // per-instance, locations 6 to 9
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out uint MaterialIndex;
+
+// per-frame camera state, shared by every program through binding point 0
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    mat4 world = model * aInstanceTransform;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;  
     TexCoords = aTexCoords;
+    MaterialIndex = aMaterialIndex;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -1,5 +1,13 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <cstdio>           // snprintf
+#include <string>           // string
+#include <fstream>          // ofstream
+#include <sstream>          // ostringstream
+#include <chrono>           // steady_clock
+#include <atomic>           // atomic
+#include <algorithm>        // sort, max
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
@@ -7,12 +15,33 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include <learnOpengl/camera.h> // Camera class
 #include <shader.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>      // Image loading Utility functions
+#include <shader_cache.h>
+#include <uniform_ring.h>
+#include <mesh_arena.h>
+#include <vertex_format.h>
+#include <mesh_builder.h>
+#include <geometry.h>
+#include <draw_batch.h>
+#include <scene_graph.h>
+#include <materials.h>
+#include <render_stats.h>
+#include <headless.h>
+#include <frame_profiler.h>
+#include <texture_loader.h>
+#include <image_flip.h>
+#include <baked_texture.h>
+#include <texture_cache.h>
+#include <block_compress.h>
+#include <thread_pool.h>
+#include <cpu_features.h>
+
+#define IMAGE_IO_IMPLEMENTATION
+#include <image_io.h>       // Image loading Utility functions
+#include <image_arena.h>
 
 
 using namespace std; // Standard namespace
@@ -31,22 +60,176 @@ namespace
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
 
-    // Stores the GL data relative to a given mesh
-    struct GLMesh
-    {
-        GLuint vao;         // Handle for the vertex array object
-        GLuint vbos[2];     // Handles for the vertex buffer objects
-        GLuint nIndices;    // Number of indices of the mesh
-    };
-
     // Main GLFW window
     GLFWwindow* gWindow = nullptr;
-    // Triangle mesh data
-    GLMesh gMesh, gMesh2, gMesh3, gMesh4, gMesh5;
-    // Texture id
-    GLuint gTextureId, gTextureId2, gTextureId3, gTextureId4, gTextureId5;
+    // Window-less context and its render target, used instead of gWindow with --headless
+    HeadlessContext gHeadlessContext;
+    OffscreenTarget gOffscreenTarget;
+    chrono::steady_clock::time_point gStartTime = chrono::steady_clock::now();
+    // Triangle mesh data, all stored in one shared arena
+    MeshArena gMeshArena;
+    GLMesh gMesh, gMesh2, gMesh3;
+    // Every mesh of the scene, submitted with one multi-draw
+    DrawBatch gDrawBatch;
+    // Vertex attributes carrying each instance's material index and transform
+    // (a mat4 takes this location and the three after it)
+    const GLuint MATERIAL_ATTRIBUTE = 3;
+    const GLuint INSTANCE_TRANSFORM_ATTRIBUTE = 6;
+    // Stress scene: buildings this far apart on a square grid behind the scene
+    const float STRESS_SPACING = 2.0f;
+    // Transform hierarchy: the scene's root, whose world matrix is the model
+    // matrix, and the stress buildings' mesh nodes (bricks, then concrete),
+    // placed in the root's space
+    SceneGraph gScene;
+    int gSceneRoot = SceneGraph::NO_PARENT;
+    std::vector<int> gStressNodes[2];
+    // The draw batch instance every node is drawn as (-1: none), and the
+    // nodes the last update moved
+    std::vector<int> gNodeInstances;
+    std::vector<int> gMovedNodes;
+    // Bytes a vertex took with position, color and texture coordinates in floats
+    const size_t LEGACY_VERTEX_SIZE = 9 * sizeof(float);
+    // Builds the meshes' normals and tangents, and the layout they are stored in
+    MeshBuilder gMeshBuilder;
+    VertexFormat gVertexFormat;
+    // Steps of the half circle the second building's roof is made of
+    const int ROOF_SEGMENTS = 10;
+
+    // Diffuse texture of every material, one array layer per material
+    MaterialArray gMaterials;
+    // Largest width and height of a material layer; --max-texture-size and
+    // --texture-budget can only make layers smaller
+    const GLsizei MATERIAL_LAYER_SIZE = 2048;
+    // Width and height every material texture is resampled to
+    GLsizei gLayerSize = MATERIAL_LAYER_SIZE;
+    // Texture memory the decoded sources would have taken above the layer size
+    std::atomic<size_t> gTextureBytesSaved(0);
+    // Material textures (relative to project's directory); a material's index is its layer
+    const char* const MATERIAL_FILES[] = {
+        "../bricks.jfif",   // 0: buildings
+        "../grass.jpg",     // 1: ground plane
+        "../concrete.jpg",  // 2: second building
+    };
+    const int MATERIAL_COUNT = sizeof(MATERIAL_FILES) / sizeof(MATERIAL_FILES[0]);
+    // Texture uploads stream through this many slots of this many bytes
+    const GLsizeiptr TEXTURE_STAGING_SLOT_SIZE = 2 * 1024 * 1024;
+    const unsigned int TEXTURE_STAGING_SLOTS = 4;
+    // Internal format of the material array; the loader threads prepare textures in it
+    GLenum gTextureFormat = GL_RGB8;
+    // Prepared textures kept between runs, and the cache key of every texture
+    // handed to the loader (0: not cached), indexed like its files
+    TextureCache gTextureCache;
+    std::vector<uint64_t> gTextureCacheKeys;
+    // Bumped whenever the preparation of textures changes what they look like
+    const uint64_t TEXTURE_CACHE_VERSION = 1;
+    // How long UCreateTextures took and how the cache served it (off, cold,
+    // partial, warm, or baked when every texture came from --bake), for the
+    // benchmark report
+    double gTexturesMs = 0.0;
+    const char* gTextureCacheState = "off";
     // Shader program
     GLuint gProgramId;
+    // Owns the compiled programs for the lifetime of the process
+    ShaderCache gShaderCache;
+    Shader* gLightingShader = nullptr;
+
+    // Uniforms of the lighting program, resolved once after it is linked
+    struct LightingUniforms
+    {
+        UniformHandle<glm::mat4> model;
+        UniformHandle<int> diffuseMaps;
+        UniformHandle<int> materialSpecular;
+        UniformHandle<float> materialShininess;
+    };
+    LightingUniforms gLightingUniforms;
+
+    // Uniform block binding points shared by every program
+    const GLuint PER_FRAME_BINDING = 0;
+    const GLuint PER_SCENE_BINDING = 1;
+
+    // std140 mirror of the PerFrame block in 5.1.light_casters.vs/.fs
+    struct PerFrameBlock
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 viewPos;      // w unused
+    };
+
+    // std140 mirror of the PerScene block in 5.1.light_casters.fs; vec3 members pad to 16 bytes
+    struct PerSceneBlock
+    {
+        glm::vec4 lightDirection;
+        glm::vec4 lightAmbient;
+        glm::vec4 lightDiffuse;
+        glm::vec4 lightSpecular;
+    };
+
+    // Directional light for the whole scene
+    PerSceneBlock gSceneLight = {
+        glm::vec4(-0.2f, -1.0f, -0.3f, 0.0f),
+        glm::vec4(1.0f, 1.0f, 1.2f, 0.0f),
+        glm::vec4(0.5f, 0.5f, 0.5f, 0.0f),
+        glm::vec4(1.0f, 1.0f, 1.0f, 0.0f)
+    };
+
+    // Triple-buffered storage for the per-frame and per-scene uniform blocks
+    UniformRing gUniformRing;
+
+    // How textures are turned the right way up for GL, whose rows start at the bottom
+    enum TextureFlip
+    {
+        FLIP_ROWS,      // swap the decoded rows on the loader threads
+        FLIP_STB,       // let stb_image flip while decoding
+        FLIP_UV         // leave the image as is and negate the V texture coordinate
+    };
+
+    // How the material textures are stored on the GPU
+    enum TextureCompression
+    {
+        COMPRESS_AUTO,  // as the baked textures are, uncompressed without them
+        COMPRESS_NONE,  // GL_RGB8, 24 bits per pixel
+        COMPRESS_BC1,   // GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4 bits per pixel
+        COMPRESS_BC7    // GL_COMPRESSED_RGBA_BPTC_UNORM, 8 bits per pixel
+    };
+
+    // Command line switches
+    struct Options
+    {
+        bool benchUniforms = false;   // --bench-uniforms: time per-frame uniform uploads and exit
+        bool benchFlip = false;       // --bench-flip: time the image flip variants on the textures and exit
+        bool benchGeometry = false;   // --bench-geometry: time generating procedural city blocks and exit
+        bool benchScene = false;      // --bench-scene: time updating a 100k node scene graph and exit
+        bool benchDecode = false;     // --bench-decode: time serial against parallel JPEG decoding and exit
+        bool checkDecodeSimd = false; // --check-decode-simd: decode with every JPEG SIMD level, compare to plain C and exit
+        bool imageArena = true;       // --no-image-arena: stb_image's scratch memory comes straight from the heap
+        bool bake = false;            // --bake: write every texture as a ready-to-upload .mtex and exit
+        std::string textureCache = "texture_cache";  // --texture-cache DIR, --no-texture-cache: where decoded textures are kept
+        int textureCacheSize = 256;   // --texture-cache-size MB: the oldest entries are dropped past it, 0 for no limit
+        bool clearTextureCache = false;  // --clear-texture-cache: delete every entry first, for a cold start
+        TextureFlip textureFlip = FLIP_ROWS;  // --flip rows|stb|uv
+        TextureCompression compression = COMPRESS_AUTO;  // --compress none|bc1|bc7, also applies to --bake
+        int maxTextureSize = 0;       // --max-texture-size N: largest layer width and height, 0 for no limit
+        int textureBudget = 0;        // --texture-budget MB: memory the material array may take, 0 for no limit
+        ResampleFilter resampleFilter = RESAMPLE_TENT;  // --resample box|tent|lanczos
+        bool headless = false;        // --headless: no window, render into an FBO through EGL
+        int frames = 0;               // --frames N: stop after N frames, 0 runs until closed
+        std::string dumpPrefix;       // --dump-frames PREFIX: write every frame to PREFIXnnnn.ppm
+        bool compactVertices = true;  // --vertex-format compact|full: half float and packed attributes, or all floats
+        NormalMode normals = NORMALS_GENERATED;  // --normals generated|flat|smooth
+        bool drawInstanced = false;   // --draw indirect|instanced: one multi-draw, or a glDrawElementsInstanced per mesh
+        int stressInstances = 0;      // --stress-instances N: add N building instances on a grid, e.g. 10000
+        bool benchmark = false;       // --benchmark: fly a scripted camera path and report frame times
+        std::string benchmarkOutput;  // --benchmark-output FILE: write the JSON report there, not to stdout
+    };
+    Options gOptions;
+
+    // Benchmark runs: frames recorded when --frames is not given, and frames
+    // rendered first so startup work (shader warm-up, first uploads) is excluded
+    const int BENCHMARK_FRAMES = 600;
+    const unsigned int BENCHMARK_WARMUP_FRAMES = 30;
+    // The benchmark always advances the same amount of time per frame
+    const float BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+    FrameProfiler gFrameProfiler;
 
     // camera
     Camera gCamera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -58,6 +241,20 @@ namespace
     // timing
     float gDeltaTime = 0.0f; // time between current frame and last frame
     float gLastFrame = 0.0f;
+    int gFrameIndex = 0;     // frames presented so far
+
+    // Counts the work done by the render loop between reports, so a shader
+    // compile or file read sneaking into a steady-state frame shows up in the log
+    struct FrameCounter
+    {
+        unsigned int frames = 0;      // frames since the last report
+        float frameTime = 0.0f;       // seconds spent in those frames
+        unsigned int fileOpens = 0;   // shader file opens during those frames
+        unsigned int compiles = 0;    // shader compiles during those frames
+        RenderStats render;           // draws and state changes during those frames
+    };
+    FrameCounter gFrameCounter;
+    const unsigned int FRAME_REPORT_INTERVAL = 600; // frames between reports
 
 }
 
@@ -66,17 +263,54 @@ namespace
  * redraw graphics on the window when resized,
  * and render graphics on the screen
  */
+void UParseArguments(int argc, char* argv[]);
 bool UInitialize(int, char* [], GLFWwindow** window);
+bool UInitializeHeadless();
+float UGetTime();
+bool UShouldClose();
+void UPresentFrame();
 void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+void UStartMeshBuild();
+void UGenerateScene(std::vector<BuiltMesh>& meshes);
+void UBenchmarkGeometry();
+void UBenchmarkScene();
+void UCreateScene();
 void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3);
-void UDestroyMesh(GLMesh& mesh);
-bool UCreateTexture(const char* filename, GLuint& textureId);
-void UDestroyTexture(GLuint textureId);
+void UReportMeshBandwidth(const char* name, const BuiltMesh& mesh, GLsizei stride);
+bool UCheckVertexLayout(const Shader& shader, const char* name);
+void UDestroyMesh();
+void UCreateDrawBatch();
+void UUpdateDrawBatch();
+void UOpenTextureCache();
+bool UCreateTextures();
+void UBenchmarkTextureLoads();
+bool UBakeTextures();
+GLenum UChooseTextureFormat();
+GLsizei UChooseLayerSize(GLenum format, GLint maxSize);
+GLenum UCompressionFormat(TextureCompression compression);
+bool UBlockFormat(GLenum format, BlockFormat& block);
+const char* UTextureFormatName(GLenum format);
+bool UTextureFormatSupported(GLenum format);
+void UBuildTextureLevels(DecodedImage& image, GLenum format);
+uint64_t UTextureCacheKey(const MappedFile& source);
+bool UUploadBakedLevels(int material, const BakedTexture& baked, const std::string& path, const char* remedy, PixelUploadRing& staging);
+void UDestroyTexture();
 void URender();
+void UCountFrame(const ShaderStats& shaderBefore, const RenderStats& renderBefore);
+void UResolveLightingUniforms(const Shader& shader);
+void UWriteFrameUniforms(const glm::mat4& projection, const glm::mat4& view);
+void UBenchmarkUniforms();
+void UBenchmarkFlip();
+void UBenchmarkDecode();
+void ULogDecodeStats();
+bool UCheckDecodeSimd();
+void UStbParallelFor(stbi_parallel_body* body, void* context, int count);
+void UBenchmarkCamera(int frame, int frames);
+bool UWriteBenchmarkReport();
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
 void UDestroyShaderProgram(GLuint programId);
 
@@ -84,10 +318,8 @@ void UDestroyShaderProgram(GLuint programId);
 /* Vertex Shader Source Code*/
 const GLchar* vertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position; // Vertex data from Vertex Attrib Pointer 0
-layout(location = 1) in vec4 color;  // Color data from Vertex Attrib Pointer 1
 layout(location = 2) in vec2 textureCoordinate;
 
-out vec4 vertexColor; // variable to transfer color data to the fragment shader
 out vec2 vertexTextureCoordinate;
 //Global variables for the  transform matrices
 uniform mat4 model;
@@ -97,7 +329,6 @@ uniform mat4 projection;
 void main()
 {
     gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
-    vertexColor = color; // references incoming color data
     vertexTextureCoordinate = textureCoordinate;
 }
 );
@@ -105,37 +336,53 @@ void main()
 
 /* Fragment Shader Source Code*/
 const GLchar* fragmentShaderSource = GLSL(440,
-    in vec4 vertexColor; // Variable to hold incoming color data from vertex shader
-in vec2 vertexTextureCoordinate;
+    in vec2 vertexTextureCoordinate;
 out vec4 fragmentColor;
 uniform sampler2D uTexture;
 void main()
 {
-    //fragmentColor = vec4(vertexColor);
     fragmentColor = texture(uTexture, vertexTextureCoordinate); // Sends texture to the GPU for rendering
 }
 );
 
-void flipImageVertically(unsigned char* image, int width, int height, int channels)
+int main(int argc, char* argv[])
 {
-    for (int j = 0; j < height / 2; ++j)
+    UParseArguments(argc, argv);
+    // stb_image spreads JPEG reconstruction over the cores
+    stbi_set_parallel_for(UStbParallelFor);
+    // and decodes out of per-thread arenas that are reused from image to image
+    if (gOptions.imageArena)
+        setImageAllocator(&ImageArena::allocator());
+
+    // Need no window or GL context
+    if (gOptions.benchFlip)
     {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
-
-        for (int i = width * channels; i > 0; --i)
-        {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
-        }
+        UBenchmarkFlip();
+        return EXIT_SUCCESS;
     }
-}
+    if (gOptions.benchGeometry)
+    {
+        UBenchmarkGeometry();
+        return EXIT_SUCCESS;
+    }
+    if (gOptions.benchScene)
+    {
+        UBenchmarkScene();
+        return EXIT_SUCCESS;
+    }
+    if (gOptions.benchDecode)
+    {
+        UBenchmarkDecode();
+        return EXIT_SUCCESS;
+    }
+    if (gOptions.checkDecodeSimd)
+        return UCheckDecodeSimd() ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (gOptions.bake)
+        return UBakeTextures() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // Meshes are generated while the window is created
+    UStartMeshBuild();
 
-int main(int argc, char* argv[])
-{
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
@@ -146,72 +393,252 @@ int main(int argc, char* argv[])
     if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
         return EXIT_FAILURE;
 
+    // Build the lighting program once; the render loop only binds it
+    gLightingShader = gShaderCache.load("5.1.light_casters.vs", "5.1.light_casters.fs");
+    if (!gLightingShader)
+        return EXIT_FAILURE;
+    UResolveLightingUniforms(*gLightingShader);
+    if (!UCheckVertexLayout(*gLightingShader, "5.1.light_casters"))
+        return EXIT_FAILURE;
 
-    // Load texture (relative to project's directory)
-    const char* texFilename = "../bricks.jfif";
-    if (!UCreateTexture(texFilename, gTextureId))
-    {
-        cout << "Failed to load texture " << texFilename << endl;
+    // Room for both uniform blocks in every frame of the ring
+    if (!gUniformRing.create(gUniformRing.align(sizeof(PerFrameBlock)) + gUniformRing.align(sizeof(PerSceneBlock))))
         return EXIT_FAILURE;
-    }
-    // Load texture (relative to project's directory)
-    const char* texFilename2 = "../grass.jpg";
-    if (!UCreateTexture(texFilename2, gTextureId2))
+
+    if (gOptions.benchUniforms)
     {
-        cout << "Failed to load texture " << texFilename2 << endl;
-        return EXIT_FAILURE;
+        UBenchmarkUniforms();
+        gUniformRing.destroy();
+        gShaderCache.clear();
+        return EXIT_SUCCESS;
     }
-    // Load texture (relative to project's directory)
-    const char* texFilename3 = "../concrete.jpg";
-    if (!UCreateTexture(texFilename3, gTextureId3))
-    {
-        cout << "Failed to load texture " << texFilename3 << endl;
+
+    // Load every material texture into its layer of the material array
+    UOpenTextureCache();
+    if (!UCreateTextures())
         return EXIT_FAILURE;
-    }
 
     // Tell OpenGL for each sampler which texture unit it belongs to (only has to be done once).
     glUseProgram(gProgramId);
     // We set the texture as texture unit 0.
     glUniform1i(glGetUniformLocation(gProgramId, "uTexture"), 0);
+    gLightingShader->use();
+    gLightingUniforms.diffuseMaps.set(0);
+    // Nothing is bound to unit 1, so specular samples black
+    gLightingUniforms.materialSpecular.set(1);
+    gLightingUniforms.materialShininess.set(32.0f);
+    // Place the scene, then queue every mesh with its material for the multi-draw
+    UCreateScene();
+    UCreateDrawBatch();
+
+    if (gOptions.benchmark)
+        gFrameProfiler.create(gOptions.frames - BENCHMARK_WARMUP_FRAMES, BENCHMARK_WARMUP_FRAMES);
+
     // Sets the background color of the window to black (it will be implicitely used by glClear)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(gWindow))
+    while (!UShouldClose())
     {
         // per-frame timing
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = UGetTime();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
         // input
         // -----
-        UProcessInput(gWindow);
+        if (gOptions.benchmark)
+        {
+            gDeltaTime = BENCHMARK_FRAME_TIME;
+            UBenchmarkCamera(gFrameIndex, gOptions.frames);
+            gFrameProfiler.beginFrame();
+        }
+        else if (!gOptions.headless)
+            UProcessInput(gWindow);
 
         // Render this frame
+        ShaderStats shaderBefore = shaderStats();
+        RenderStats renderBefore = renderStats();
         URender();
+        if (gOptions.benchmark)
+            gFrameProfiler.endGpuWork();
+        UCountFrame(shaderBefore, renderBefore);
 
-        glfwPollEvents();
+        UPresentFrame();
+        if (gOptions.benchmark)
+            gFrameProfiler.endFrame();
+    }
+
+    int status = EXIT_SUCCESS;
+    if (gOptions.benchmark)
+    {
+        UBenchmarkTextureLoads();
+        if (!UWriteBenchmarkReport())
+            status = EXIT_FAILURE;
+        gFrameProfiler.destroy();
     }
 
     // Release mesh data
-    UDestroyMesh(gMesh);
+    gDrawBatch.destroy();
+    UDestroyMesh();
 
     // Release texture
-    UDestroyTexture(gTextureId);
+    UDestroyTexture();
 
     // Release shader program
     UDestroyShaderProgram(gProgramId);
+    gUniformRing.destroy();
+    gShaderCache.clear();
+
+    if (gOptions.headless)
+    {
+        gOffscreenTarget.destroy();
+        gHeadlessContext.destroy();
+    }
+
+    exit(status); // Terminates the program
+}
+
+
+// Reads the command line switches into gOptions
+void UParseArguments(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench-uniforms") == 0)
+            gOptions.benchUniforms = true;
+        else if (strcmp(argv[i], "--bench-flip") == 0)
+            gOptions.benchFlip = true;
+        else if (strcmp(argv[i], "--bench-geometry") == 0)
+            gOptions.benchGeometry = true;
+        else if (strcmp(argv[i], "--bench-scene") == 0)
+            gOptions.benchScene = true;
+        else if (strcmp(argv[i], "--bench-decode") == 0)
+            gOptions.benchDecode = true;
+        else if (strcmp(argv[i], "--check-decode-simd") == 0)
+            gOptions.checkDecodeSimd = true;
+        else if (strcmp(argv[i], "--no-image-arena") == 0)
+            gOptions.imageArena = false;
+        else if (strcmp(argv[i], "--bake") == 0)
+            gOptions.bake = true;
+        else if (strcmp(argv[i], "--texture-cache") == 0 && i + 1 < argc)
+            gOptions.textureCache = argv[++i];
+        else if (strcmp(argv[i], "--no-texture-cache") == 0)
+            gOptions.textureCache.clear();
+        else if (strcmp(argv[i], "--texture-cache-size") == 0 && i + 1 < argc)
+            gOptions.textureCacheSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--clear-texture-cache") == 0)
+            gOptions.clearTextureCache = true;
+        else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "compact") == 0)
+                gOptions.compactVertices = true;
+            else if (strcmp(mode, "full") == 0)
+                gOptions.compactVertices = false;
+            else
+                cout << "Ignoring unknown vertex format " << mode << ", expected compact or full" << endl;
+        }
+        else if (strcmp(argv[i], "--normals") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "generated") == 0)
+                gOptions.normals = NORMALS_GENERATED;
+            else if (strcmp(mode, "flat") == 0)
+                gOptions.normals = NORMALS_FLAT;
+            else if (strcmp(mode, "smooth") == 0)
+                gOptions.normals = NORMALS_SMOOTH;
+            else
+                cout << "Ignoring unknown normal mode " << mode << ", expected generated, flat or smooth" << endl;
+        }
+        else if (strcmp(argv[i], "--draw") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "indirect") == 0)
+                gOptions.drawInstanced = false;
+            else if (strcmp(mode, "instanced") == 0)
+                gOptions.drawInstanced = true;
+            else
+                cout << "Ignoring unknown draw path " << mode << ", expected indirect or instanced" << endl;
+        }
+        else if (strcmp(argv[i], "--stress-instances") == 0 && i + 1 < argc)
+            gOptions.stressInstances = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--flip") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "rows") == 0)
+                gOptions.textureFlip = FLIP_ROWS;
+            else if (strcmp(mode, "stb") == 0)
+                gOptions.textureFlip = FLIP_STB;
+            else if (strcmp(mode, "uv") == 0)
+                gOptions.textureFlip = FLIP_UV;
+            else
+                cout << "Ignoring unknown flip mode " << mode << ", expected rows, stb or uv" << endl;
+        }
+        else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "none") == 0)
+                gOptions.compression = COMPRESS_NONE;
+            else if (strcmp(mode, "bc1") == 0)
+                gOptions.compression = COMPRESS_BC1;
+            else if (strcmp(mode, "bc7") == 0)
+                gOptions.compression = COMPRESS_BC7;
+            else
+                cout << "Ignoring unknown compression " << mode << ", expected none, bc1 or bc7" << endl;
+        }
+        else if (strcmp(argv[i], "--max-texture-size") == 0 && i + 1 < argc)
+            gOptions.maxTextureSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            gOptions.textureBudget = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--resample") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "box") == 0)
+                gOptions.resampleFilter = RESAMPLE_BOX;
+            else if (strcmp(mode, "tent") == 0)
+                gOptions.resampleFilter = RESAMPLE_TENT;
+            else if (strcmp(mode, "lanczos") == 0)
+                gOptions.resampleFilter = RESAMPLE_LANCZOS;
+            else
+                cout << "Ignoring unknown resample filter " << mode << ", expected box, tent or lanczos" << endl;
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+            gOptions.headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            gOptions.frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc)
+            gOptions.dumpPrefix = argv[++i];
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            gOptions.benchmark = true;
+        else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc)
+            gOptions.benchmarkOutput = argv[++i];
+        else
+            cout << "Ignoring unknown argument " << argv[i] << endl;
+    }
 
-    exit(EXIT_SUCCESS); // Terminates the program successfully
+    // A benchmark records a fixed number of frames after its warm-up
+    if (gOptions.benchmark)
+    {
+        if (gOptions.frames <= 0)
+            gOptions.frames = BENCHMARK_FRAMES;
+        gOptions.frames += BENCHMARK_WARMUP_FRAMES;
+    }
+
+    // Without a window nothing would ever end the render loop
+    if (gOptions.headless && gOptions.frames <= 0)
+        gOptions.frames = 1;
 }
 
 
 // Initialize GLFW, GLEW, and create a window
 bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 {
+    if (gOptions.headless)
+        return UInitializeHeadless();
+
     // GLFW: initialize and configure
     // ------------------------------
     glfwInit();
@@ -259,6 +686,90 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 }
 
 
+// Create a window-less GL 4.4 core context through EGL and an offscreen
+// framebuffer of the window's size to render into
+bool UInitializeHeadless()
+{
+    if (!gHeadlessContext.create(4, 4))
+        return false;
+
+    // GLEW: initialize
+    // ----------------
+    // A GLEW built for GLX loads every entry point and then fails to find an
+    // X display, which does not matter without a window
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewInit();
+
+    if (GLEW_OK != GlewInitResult && GLEW_ERROR_NO_GLX_DISPLAY != GlewInitResult)
+    {
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
+    }
+
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << " (headless, " << glGetString(GL_RENDERER) << ")" << endl;
+
+    // There is no default framebuffer; everything renders into this one
+    return gOffscreenTarget.create(WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+
+// Seconds since startup, from GLFW when it owns the context
+float UGetTime()
+{
+    if (!gOptions.headless)
+        return (float)glfwGetTime();
+    chrono::duration<float> elapsed = chrono::steady_clock::now() - gStartTime;
+    return elapsed.count();
+}
+
+
+// Whether the render loop should stop: window closed or frame limit reached
+bool UShouldClose()
+{
+    if (gOptions.frames > 0 && gFrameIndex >= gOptions.frames)
+        return true;
+    return !gOptions.headless && glfwWindowShouldClose(gWindow);
+}
+
+
+// Shows the finished frame: swaps the window, or writes it out when dumping
+void UPresentFrame()
+{
+    if (!gOptions.dumpPrefix.empty())
+    {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "%04d.ppm", gFrameIndex);
+        if (gOptions.headless)
+            gOffscreenTarget.writePPM((gOptions.dumpPrefix + suffix).c_str());
+        else
+            cout << "WARNING: --dump-frames needs --headless" << endl;
+    }
+
+    if (!gOptions.headless)
+    {
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+        glfwPollEvents();
+    }
+
+    // Startup ends when the first frame has actually been drawn
+    if (gFrameIndex == 0)
+    {
+        glFinish();
+        chrono::duration<double, milli> startup = chrono::steady_clock::now() - gStartTime;
+        cout << "INFO: Startup to first frame: " << startup.count() << " ms, textures " << gTexturesMs
+            << " ms, texture cache " << gTextureCacheState << endl;
+        if (gOptions.benchmark)
+        {
+            gFrameProfiler.setStartup(startup.count(), gTexturesMs, gTextureCacheState);
+            gFrameProfiler.setScene(gDrawBatch.instanceCount(), gDrawBatch.triangleCount());
+        }
+    }
+    gFrameIndex++;
+}
+
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 void UProcessInput(GLFWwindow* window)
 {
@@ -379,14 +890,12 @@ void URender()
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(2.0f, 2.0f, 2.0f));
-    // 2. Rotates shape by 15 degrees in the x+y axis
-    glm::mat4 rotation = glm::rotate(15.0f, glm::vec3(0.0, 1.0f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(0.0f, 0.0f, -14.0f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
+    // Model matrix: the world matrix of the scene's root, recomputed only
+    // when a node of the scene moved, like the stress instances' transforms
+    gMovedNodes.clear();
+    if (gScene.update(&gMovedNodes) != 0)
+        UUpdateDrawBatch();
+    const glm::mat4& model = gScene.world(gSceneRoot);
 
     // Transforms the camera: move the camera back (z axis)
     //glm::mat4 view = glm::translate(glm::vec3(0.0f, 0.0f, -5.0f));
@@ -400,418 +909,823 @@ void URender()
     // Creates a orthographic projection
     glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-    // Set the shader to be used
-    glUseProgram(gProgramId);
-
-    Shader lightingShader("5.1.light_casters.vs", "5.1.light_casters.fs");
-    // shader configuration
-    // --------------------
-    lightingShader.use();
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setInt("material.specular", 1);
+    // camera and light state for every program drawn this frame
+    gUniformRing.beginFrame();
+    UWriteFrameUniforms(projection, view);
 
     // be sure to activate shader when setting uniforms/drawing objects
-    lightingShader.use();
-    lightingShader.setVec3("light.direction", -0.2f, -1.0f, -0.3f);
-    lightingShader.setVec3("viewPos", gCamera.Position);
+    gLightingShader->use();
 
-    // light properties
-    lightingShader.setVec3("light.ambient", 1.0f, 1.0f, 1.2f);
-    lightingShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-    lightingShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+    // world transformation
+    gLightingUniforms.model.set(model);
 
-    // material properties
-    lightingShader.setFloat("material.shininess", 32.0f);
+    // Activate the shared VAO holding every mesh
+    gMeshArena.bind();
 
-    // view/projection transformations
-    //glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //glm::mat4 view = gCamera.GetViewMatrix();
-    lightingShader.setMat4("projection", projection);
-    lightingShader.setMat4("view", view);
+    // Every material's diffuse map is a layer of this array; the shader picks one per draw
+    gMaterials.bind(0);
 
-    // world transformation
-    //glm::mat4 model = glm::mat4(1.0f);
-    lightingShader.setMat4("model", model);
+    // Draws the triangles of every mesh and instance in one call, or in one
+    // instanced call per mesh
+    if (gOptions.drawInstanced)
+        gDrawBatch.drawInstanced();
+    else
+        gDrawBatch.draw();
 
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
 
-    //glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    //glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    //glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Deactivate the Vertex Array Object
+    glBindVertexArray(0);
 
-    // Activate the VBOs contained within the mesh's VAO
-    glBindVertexArray(gMesh.vao);
+    // The GPU is done with this frame's uniform blocks once these draws complete
+    gUniformRing.endFrame();
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
 
-    // Draws the triangles
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+// Accumulates the cost of the frame just rendered and periodically logs it
+void UCountFrame(const ShaderStats& shaderBefore, const RenderStats& renderBefore)
+{
+    const ShaderStats& after = shaderStats();
+    unsigned int fileOpens = after.fileOpens - shaderBefore.fileOpens;
+    unsigned int compiles = after.compiles - shaderBefore.compiles;
+    const RenderStats& render = renderStats();
+
+    if (fileOpens != 0 || compiles != 0)
+        cout << "WARNING: frame did " << compiles << " shader compiles and " << fileOpens << " shader file opens" << endl;
+
+    gFrameCounter.frames++;
+    gFrameCounter.frameTime += gDeltaTime;
+    gFrameCounter.fileOpens += fileOpens;
+    gFrameCounter.compiles += compiles;
+    gFrameCounter.render.drawCalls += render.drawCalls - renderBefore.drawCalls;
+    gFrameCounter.render.programBinds += render.programBinds - renderBefore.programBinds;
+    gFrameCounter.render.textureBinds += render.textureBinds - renderBefore.textureBinds;
+    gFrameCounter.render.vertexArrayBinds += render.vertexArrayBinds - renderBefore.vertexArrayBinds;
+    gFrameCounter.render.bufferBinds += render.bufferBinds - renderBefore.bufferBinds;
+
+    if (gFrameCounter.frames == FRAME_REPORT_INTERVAL)
+    {
+        const float frames = (float)gFrameCounter.frames;
+        cout << "INFO: " << gFrameCounter.frames << " frames, "
+            << 1000.0f * gFrameCounter.frameTime / frames << " ms/frame, "
+            << gFrameCounter.compiles << " shader compiles, "
+            << gFrameCounter.fileOpens << " shader file opens" << endl;
+        cout << "INFO:   per frame: " << gFrameCounter.render.drawCalls / frames << " draws, "
+            << gFrameCounter.render.programBinds / frames << " program binds, "
+            << gFrameCounter.render.textureBinds / frames << " texture binds, "
+            << gFrameCounter.render.vertexArrayBinds / frames << " VAO binds, "
+            << gFrameCounter.render.bufferBinds / frames << " buffer binds" << endl;
+        gFrameCounter = FrameCounter();
+    }
+}
 
-    glBindVertexArray(gMesh2.vao);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureId2);
+// Looks up every uniform URender sets, once, after the program is linked
+void UResolveLightingUniforms(const Shader& shader)
+{
+    shader.bindUniformBlock("PerFrame", PER_FRAME_BINDING);
+    shader.bindUniformBlock("PerScene", PER_SCENE_BINDING);
 
-    // Draws the triangles
-    glDrawElements(GL_TRIANGLES, gMesh2.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    gLightingUniforms.model = shader.uniform<glm::mat4>("model");
+    gLightingUniforms.diffuseMaps = shader.uniform<int>("diffuseMaps");
+    gLightingUniforms.materialSpecular = shader.uniform<int>("material.specular");
+    gLightingUniforms.materialShininess = shader.uniform<float>("material.shininess");
+}
 
-    glBindVertexArray(gMesh3.vao);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
+// Writes the camera and light blocks into the current frame of the uniform
+// ring and binds them; programs switched to later in the frame need no uploads
+void UWriteFrameUniforms(const glm::mat4& projection, const glm::mat4& view)
+{
+    PerFrameBlock perFrame;
+    perFrame.projection = projection;
+    perFrame.view = view;
+    perFrame.viewPos = glm::vec4(gCamera.Position, 1.0f);
 
-    // Draws the triangles
-    glDrawElements(GL_TRIANGLES, gMesh3.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    gUniformRing.write(PER_FRAME_BINDING, &perFrame, sizeof(perFrame));
+    gUniformRing.write(PER_SCENE_BINDING, &gSceneLight, sizeof(gSceneLight));
+}
 
 
-    // Deactivate the Vertex Array Object
-    glBindVertexArray(0);
+// Times the uniform uploads of one URender frame. The default-block uniforms
+// are set three ways: the old path (glGetUniformLocation with a std::string
+// temporary per call), by name through the reflected location table, and
+// through pre-resolved handles. The camera and light blocks are timed as one
+// write into the uniform ring.
+// Run with LIBGL_ALWAYS_SOFTWARE=1 to measure Mesa's software driver.
+void UBenchmarkUniforms()
+{
+    const int FRAMES = 20000;
+    const Shader& shader = *gLightingShader;
+    const glm::mat4 model(1.0f);
+    const glm::mat4 view = gCamera.GetViewMatrix();
+    const glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+
+    // what Shader::setX did before the location table existed
+    auto lookupMat4 = [&](const std::string& name, const glm::mat4& mat) { glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, &mat[0][0]); };
+    auto lookupInt = [&](const std::string& name, int value) { glUniform1i(glGetUniformLocation(shader.ID, name.c_str()), value); };
+    auto lookupFloat = [&](const std::string& name, float value) { glUniform1f(glGetUniformLocation(shader.ID, name.c_str()), value); };
+
+    glUseProgram(shader.ID);
+    cout << "INFO: Uniform benchmark on " << glGetString(GL_RENDERER) << ", " << FRAMES << " frames" << endl;
+
+    const char* const names[] = { "glGetUniformLocation", "location table", "UniformHandle", "uniform ring blocks" };
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        glFinish();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            if (pass == 0)
+            {
+                lookupInt("diffuseMaps", 0);
+                lookupInt("material.specular", 1);
+                lookupFloat("material.shininess", 32.0f);
+                lookupMat4("model", model);
+            }
+            else if (pass == 1)
+            {
+                shader.setInt("diffuseMaps", 0);
+                shader.setInt("material.specular", 1);
+                shader.setFloat("material.shininess", 32.0f);
+                shader.setMat4("model", model);
+            }
+            else if (pass == 2)
+            {
+                gLightingUniforms.diffuseMaps.set(0);
+                gLightingUniforms.materialSpecular.set(1);
+                gLightingUniforms.materialShininess.set(32.0f);
+                gLightingUniforms.model.set(model);
+            }
+            else
+            {
+                gUniformRing.beginFrame();
+                UWriteFrameUniforms(projection, view);
+                gUniformRing.endFrame();
+            }
+        }
+        glFinish();
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        cout << "INFO:   " << names[pass] << ": " << elapsed.count() / FRAMES << " us/frame" << endl;
+    }
+}
+
+
+// Times every way of flipping the shipped textures, rows swapped in place
+// with each FlipMethod and flipped by stb_image while decoding, and checks
+// that all of them produce the same image
+void UBenchmarkFlip()
+{
+    const int REPEATS = 5;
+    cout << "INFO: Flip benchmark, " << REPEATS << " flips per texture, AVX2 "
+        << (flipMethodAvailable(FLIP_AVX2) ? "available" : "not available") << endl;
+
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        MappedFile file;
+        if (!file.open(MATERIAL_FILES[i]))
+        {
+            cout << "Failed to load texture " << MATERIAL_FILES[i] << endl;
+            continue;
+        }
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(0);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        unsigned char* image = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &channels, 0);
+        chrono::duration<double, milli> decode = chrono::steady_clock::now() - start;
+        if (!image)
+        {
+            cout << "Failed to load texture " << MATERIAL_FILES[i] << endl;
+            continue;
+        }
+        const size_t bytes = (size_t)width * height * channels;
+        cout << "INFO: " << MATERIAL_FILES[i] << " " << width << "x" << height << "x" << channels
+            << ", decode " << decode.count() << " ms" << endl;
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+        // the original loop flips the reference copy
+        std::vector<unsigned char> reference(image, image + bytes);
+        flipImageVertically(reference.data(), width, height, channels, FLIP_BYTES);
+
+        std::vector<unsigned char> work(bytes);
+        for (int method = FLIP_BYTES; method < FLIP_BEST; ++method)
+        {
+            if (!flipMethodAvailable((FlipMethod)method))
+                continue;
+            double total = 0.0;
+            bool matches = true;
+            for (int r = 0; r < REPEATS; ++r)
+            {
+                memcpy(work.data(), image, bytes);
+                start = chrono::steady_clock::now();
+                flipImageVertically(work.data(), width, height, channels, (FlipMethod)method);
+                total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                matches = matches && memcmp(work.data(), reference.data(), bytes) == 0;
+            }
+            double ms = total / REPEATS;
+            cout << "INFO:   " << flipMethodName((FlipMethod)method) << ": " << ms << " ms, "
+                << bytes / (ms * 1.0e6) << " GB/s" << (matches ? "" : ", WRONG RESULT") << endl;
+        }
+        stbi_image_free(image);
+
+        // flipping while decoding costs the difference in decode time
+        stbi_set_flip_vertically_on_load(1);
+        start = chrono::steady_clock::now();
+        image = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &channels, 0);
+        chrono::duration<double, milli> flippedDecode = chrono::steady_clock::now() - start;
+        stbi_set_flip_vertically_on_load(0);
+        if (image)
+        {
+            bool matches = memcmp(image, reference.data(), bytes) == 0;
+            cout << "INFO:   stbi flip on load: " << flippedDecode.count() - decode.count() << " ms over the plain decode"
+                << (matches ? "" : ", WRONG RESULT") << endl;
+            stbi_image_free(image);
+        }
+    }
+    cout << "INFO:   --flip uv: 0 ms, the texture coordinates are negated once at mesh creation" << endl;
 }
 
 
-// Implements the UCreateMesh function
-void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3)
+// Decodes every texture from memory with stb_image's work on the calling
+// thread only, then with it spread over the shared thread pool, and checks
+// that both give the same pixels
+void UBenchmarkDecode()
 {
-    // Position and Color data
-    GLfloat verts[] = {
-        // Vertex Positions    // Colors (r,g,b,a) //Texture Coordinates
-
-        //Building shapes in a 5x6 grid, starting at -1.0 and going to 1.0, with an offset of 0.25 for each gridline.
-        //Left side of base 
-        -0.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, -5.0f, //Back left bottom - Point 0
-        -0.5f, -0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, -5.0f,//Front left bottom. - Point 1
-        -0.5f,  0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 5.0f,//Back left top - Point 2 
-        -0.5f,  0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 5.0f,//Front left top - Point 3
-
-        //Right side of base.
-        0.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, -5.0f,//Back right bottom - Point 4
-        0.5f, -0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, -5.0f,//Front right bottom - Point 5
-        0.5f,  0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 5.0f,//Back right top - Point 6
-        0.5f,  0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 5.0f,//Front right top - Point 7
-
-        //Top left Addon.
-        //Uses points 2, 3 for Bottom left back and Bottom left front
-        -0.5f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 7.0f,//Back left top - Point 8
-        -0.5f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 7.0f,//Front left top - Point 9.
-        -0.3f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -3.0f, 7.0f,//Back right top - Point 10.
-        -0.3f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -3.0f, 7.0f,//Front right top - Point 11.
-        -0.3f, 0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -3.0f, 5.0f,//Back right bottom - Point 12.
-        -0.3f, 0.5f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -3.0f, 5.0f,//Front right bottom - Point 13.
-
-        //Top right addon.
-        //Uses points 6, 7, for bottom back right and bottom front right
-        0.5f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 7.0f,//Back right top - Point 14
-        0.5f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 7.0f,//Front right top - Point 15
-        0.3f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 3.0, 7.0f,//Back left top - Point 16
-        0.3f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 3.0f, 7.0f,//Front left top - Point 17
-        0.3f, 0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 3.0f, 5.0f,//Back left bottom - Point 18.
-        0.3f, 0.5f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 3.0f, 5.0f,//Front left bottom - Point 19.
-
-        //Top middle addon.
-        //This shape has no points shared with the other, so lets make the left and the right side separate. 
-        0.1f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 1.0f, 7.0f,//Back right top - Point 20
-        0.1f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 1.0f, 7.0f,//Front right top - Point 21
-        0.1f, 0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 1.0f, 5.0f,//Back right bottom - Point 22
-        0.1f, 0.5f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 1.0f, 5.0f,//Front right bottom - Point 23
-        -0.1f, 0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -1.0f, 7.0f,//Back left top - Point 24
-       -0.1f, 0.7f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -1.0f, 7.0f,//Front left top - Point 25
-       -0.1f, 0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -1.0f, 5.0f, //Back left bottom - Point 26
-       -0.1f, 0.5f, 0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -1.0f, 5.0f,//Front left bottom - Point 27
-
-
-       //Plane on the ground.
-       -5.0f, -0.5f, -5.0f, 0.5f, 0.75f, 0.3f, 1.0f, 0.0f, 0.0f,//Back left - Point 28
-       -5.0f, -0.5f, 5.0f, 0.5f, 0.75f, 0.3f, 1.0f, 5.0f, 0.0f,//Front left - Point 29
-       5.0f, -0.5f, -5.0f, 0.5f, 0.75f, 0.3f, 1.0f, 0.0f, 5.0f,//Back right - Point 30
-       5.0f, -0.5f, 5.0f, 0.5f, 0.75f, 0.3f, 1.0f, 5.0f, 5.0f,//Front right - Point 31
-
-        //Left side of base 
-        -0.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, -5.0f, //Back left bottom - Point 32
-        -0.5f, -0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, -5.0f,//Front left bottom. - Point 33
-        -0.5f,  0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 7.0f,//Back left top - Point 34 
-        -0.5f,  0.7f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 7.0f,//Front left top - Point 35
-
-         //Right side of base.
-        0.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, -5.0f,//Back right bottom - Point 36
-        0.5f, -0.5f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, -5.0f,//Front right bottom - Point 37
-        0.5f,  0.7f, -0.5f, 0.66f, 0.66f, 0.66f, 1.0f, -5.0f, 7.0f,//Back right top - Point 38
-        0.5f,  0.7f,  0.5f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 7.0f,//Front right top - Point 39
-
-        //Next building - Left Wall
-        -2.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 0.0f, 0.0f, 0.0f, //Back left bottom- Point 40
-        -3.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 5.0f, //Front left bottom- Point 41
-        -3.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 0.0f, 5.0f, 0.0f, //Front left top - Point 42
-        -2.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 5.0f, 5.0f, //Back left top - Point 43
-
-        //Next Building - Front Wall
-        -3.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Front left bottom- Point 44
-        -3.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 0.0f, 5.0f, 0.0f, //Front left top - Point 45
-        -3.5f, -0.5f, 1.0f, 0.66f, 0.66f, 0.66f, 1.0f, 0.0f, 5.0f, //Front right bottom - Point 46
-        -3.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 5.0f, //Front right top - Point 47. 
-
-        //Next Building - Right Wall
-        -2.5f, -0.5f,  1.0f, 0.66f, 0.66f, 0.66f, 0.0f, 0.0f, 0.0f, //Back left bottom- Point 48
-        -3.5f, -0.5f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 5.0f, //Front left bottom- Point 49
-        -3.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 0.0f, 5.0f, 0.0f, //Front left top - Point 50
-        -2.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 5.0f, 5.0f, //Back left top - Point 51
-
-        //Next Building - Back Wall
-        -2.5f, -0.5f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Front left bottom- Point 52
-        -2.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 0.0f, 5.0f, 0.0f, //Front left top - Point 53
-        -2.5f, -0.5f, 1.0f, 0.66f, 0.66f, 0.66f, 1.0f, 0.0f, 5.0f, //Front right bottom - Point 54
-        -2.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 1.0f, 5.0f, 5.0f, //Front right top - Point 55
-
-        -3.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 0.0f, 0.0f, 0.0f, //Front left top - Point 56
-        -2.5f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Back left top - Point 57
-        -3.0f, -0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 58
-        -3.0f, 0.4f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 59
-        -3.3f, 0.3f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 60
-        -3.2f, 0.36f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 61
-        -3.4f, 0.2f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 62
-        -2.7f, 0.3f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 63
-        -2.8f, 0.36f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 64
-        -2.6f, 0.2f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 65
-        -2.55f, 0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 66
-        -3.45f, 0.1f, -0.5f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 67
-
-        -3.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 0.0f, 0.0f, 0.0f, //Front left top - Point 68
-        -2.5f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Back left top - Point 69
-        -3.0f, -0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 70
-        -3.0f, 0.4f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 71
-        -3.3f, 0.3f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 72
-        -3.2f, 0.36f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 73
-        -3.4f, 0.2f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 74
-        -2.7f, 0.3f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 75
-        -2.8f, 0.36f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 76
-        -2.6f, 0.2f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 77
-        -2.55f, 0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 78
-        -3.45f, 0.1f, 1.0f, 0.66f, 0.66f, 0.66f, 5.0f, 0.0f, 0.0f, //Center bottom - Point 79
-    };
+    const int REPEATS = 3;
+    cout << "INFO: Decode benchmark, best of " << REPEATS << " decodes per texture, "
+        << sharedThreadPool().concurrency() << " threads" << endl;
 
-    // Index data to share position data
-    GLushort indices[] = {
-
-        //Basic Building Shape
-        //Left side
-        32, 33, 35,
-        32, 34, 35,
-        //Right side
-       36, 37, 39,
-       36, 38, 39,
-       //Bottom
-       0, 1, 5,
-       0, 4, 5,
-       //Front
-       1, 3, 5,
-       3, 5, 7,
-       //Back
-       0, 2, 4,
-       2, 4, 6,
-       //Top
-       2, 3, 7,
-       2, 7, 6,
-
-       //Top left addon
-       //Left side
-      // 2, 3, 8,
-      // 3, 8, 9,
-       //Front
-       3, 9, 13,
-       9, 11, 13,
-       //Top
-       8, 9, 10,
-       9, 10, 11,
-       //Back
-       2, 8, 10,
-       2, 10, 12,
-       //Right side
-       10, 11, 12,
-       11, 12, 13,
-       //Bottom is covered by the top of the bigger shape already. 
-
-       //Top right addon.
-       //Left side
-       16, 17, 18,
-       17, 18, 19,
-       //Front
-       15, 17, 19,
-       15, 19, 7,
-       //Top
-       14, 15, 16,
-       15, 16, 17,
-       //Back
-       14, 16, 6,
-       16, 18, 6,
-       //Right side
-      // 14, 15, 6,
-       //15, 7, 6,
-       //Bottom is covered by the top of the bigger shape already.
-
-       //Top center addon.
-       //Bottom still covered, even though this doesn't share any points with the other objects. 
-       //Left side 
-       24, 25, 26,
-       25, 26, 27,
-       //Right side
-       20, 21, 22,
-       21, 22, 23,
-       //Front
-       21, 23, 25,
-       23, 25, 27,
-       //Back
-       20, 22, 24,
-       22, 24, 26,
-       //Top
-       20, 21, 25,
-       20, 24, 25,
-    };
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        MappedFile data;
+        if (!data.open(MATERIAL_FILES[i]))
+        {
+            cout << "Failed to load texture " << MATERIAL_FILES[i] << endl;
+            continue;
+        }
 
-    GLushort indices2[] = {
-        //Plane
-        28, 29, 30,
-        29, 30, 31,
-    };
+        double best[2] = { 0.0, 0.0 };
+        std::vector<unsigned char> pixels[2];
+        int width = 0, height = 0, channels = 0;
+        for (int parallel = 0; parallel < 2; ++parallel)
+        {
+            stbi_set_parallel_for(parallel ? UStbParallelFor : nullptr);
+            for (int r = 0; r < REPEATS; ++r)
+            {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                ImageInfo info;
+                unsigned char* image = decodeImage(data.data(), data.size(), info);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                if (image == nullptr)
+                    break;
+                if (r == 0 || ms < best[parallel])
+                    best[parallel] = ms;
+                width = info.width;
+                height = info.height;
+                channels = info.channels;
+                pixels[parallel].assign(image, image + (size_t)width * height * channels);
+                freeImage(image);
+            }
+        }
+        stbi_set_parallel_for(UStbParallelFor);
+
+        bool matches = !pixels[0].empty() && pixels[0] == pixels[1];
+        cout << "INFO: " << MATERIAL_FILES[i] << " " << width << "x" << height << "x" << channels
+            << ": serial " << best[0] << " ms, parallel " << best[1] << " ms, "
+            << best[0] / best[1] << "x" << (matches ? "" : ", WRONG RESULT") << endl;
+    }
+}
+
+
+// Generates procedural city blocks, each a lot with four buildings, their
+// rounded roofs and four round props, into one buffer reused batch after
+// batch, at several tessellations. Reports primitives generated per second
+// against the 100k a second city generation needs.
+void UBenchmarkGeometry()
+{
+    const int TESSELLATIONS[] = { 4, 8, 16, 32 };
+    const int PRIMITIVES_PER_BLOCK = 13;
+    const double TARGET_PER_SECOND = 100000.0;
+    const double RUN_MS = 250.0;
+    const float BLOCK_SIZE = 4.0f;
+    const float PI = glm::pi<float>();
+    cout << "INFO: Geometry benchmark, " << PRIMITIVES_PER_BLOCK << " primitives per city block, "
+        << RUN_MS << " ms per tessellation" << endl;
+
+    for (int segments : TESSELLATIONS)
+    {
+        GeometryCounts block = quadCounts();
+        for (int i = 0; i < 4; ++i)
+        {
+            block += boxCounts(BOX_ALL_FACES & ~BOX_BOTTOM);
+            block += arcCounts(segments);
+            block += cylinderCounts(segments);
+        }
+        // as many blocks as one buffer's 16 bit indices can address
+        const size_t blocksPerBatch = 65536 / block.vertices;
+        std::vector<SourceVertex> vertices(block.vertices * blocksPerBatch);
+        std::vector<GLushort> indices(block.indices * blocksPerBatch);
+        GeometryBuffer buffer(vertices.data(), vertices.size(), indices.data(), indices.size());
+
+        size_t blocks = 0, primitives = 0, vertexCount = 0, failed = 0;
+        float checksum = 0.0f;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        double ms = 0.0;
+        while (ms < RUN_MS)
+        {
+            buffer.clear();
+            for (size_t b = 0; b < blocksPerBatch; ++b, ++blocks)
+            {
+                // blocks on a 64 wide grid, buildings in the lot's quarters
+                const float x = (blocks % 64) * BLOCK_SIZE, z = (blocks / 64 % 64) * BLOCK_SIZE;
+                const float height = 1.0f + (blocks % 7) * 0.25f;
+                bool added = addQuad(buffer, glm::vec3(x, 0.0f, z + BLOCK_SIZE), glm::vec3(BLOCK_SIZE, 0.0f, 0.0f),
+                    glm::vec3(0.0f, 0.0f, -BLOCK_SIZE), BLOCK_SIZE, BLOCK_SIZE);
+                for (int i = 0; i < 4; ++i)
+                {
+                    const float left = x + 0.25f + (i & 1) * 2.0f, back = z + 0.25f + (i >> 1) * 2.0f;
+                    added &= addBox(buffer, glm::vec3(left, 0.0f, back), glm::vec3(left + 1.5f, height, back + 1.0f),
+                        5.0f, BOX_ALL_FACES & ~BOX_BOTTOM);
+                    added &= addArc(buffer, glm::vec3(left + 0.75f, height, back), 0.75f, 0.0f, PI, 1.0f, segments, 5.0f);
+                    added &= addCylinder(buffer, glm::vec3(left + 0.75f, 0.0f, back + 1.5f), 0.1f, 0.8f, segments, 5.0f);
+                }
+                failed += added ? 0 : 1;
+            }
+            primitives += blocksPerBatch * PRIMITIVES_PER_BLOCK;
+            vertexCount += buffer.vertexCount;
+            // read back what was written so none of it can be skipped
+            checksum += buffer.vertices[buffer.vertexCount - 1].position[1] + buffer.indices[buffer.indexCount - 1];
+            ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+
+        const double perSecond = primitives / (ms / 1000.0);
+        cout << "INFO:   " << segments << " segments: " << perSecond / 1000.0 << "k primitives/s, "
+            << vertexCount / (ms / 1000.0) / 1.0e6 << "M vertices/s, "
+            << vertexCount * sizeof(SourceVertex) / (ms * 1.0e3) << " MB/s, "
+            << block.vertices << " vertices per block, "
+            << (perSecond >= TARGET_PER_SECOND ? "meets" : "MISSES") << " the 100k/s target"
+            << (failed == 0 ? "" : ", OVERFLOWED") << " (checksum " << checksum << ")" << endl;
+    }
+}
 
-    GLushort indices3[] = {
-        42, 41, 40,
-        40, 42, 43,
-        44, 45, 46,
-        45, 46, 47,
-        48, 49, 50,
-        48, 50, 51,
-        52, 53, 54,
-        53, 54, 55,
-        58, 56, 67,
-        58, 67, 62,
-        58, 62, 60,
-        58, 60, 61,
-        58, 61, 59,
-        58, 59, 64,
-        58, 64, 63,
-        58, 63, 65,
-        58, 65, 66,
-        58, 66, 57,
-
-        70, 68, 79,
-        70, 79, 74,
-        70, 74, 72,
-        70, 72, 73,
-        70, 73, 71,
-        70, 71, 76,
-        70, 76, 75,
-        70, 75, 77,
-        70, 77, 78,
-        70, 78, 69,
-
-        //Then the roof
-        56, 68, 67,
-        68, 67, 74,
-        67, 74, 62,
-        67, 74, 79,
-        62, 74, 60,
-        60, 74, 72,
-        60, 61, 73,
-        72, 73, 60,
-        61, 59, 73,
-        73, 71, 59,
-        59, 64, 76,
-        59, 71, 76,
-        64, 76, 75,
-        63, 75, 64,
-        63, 75, 77,
-        63, 65, 77,
-        65, 77, 78,
-        65, 78, 66,
-        66, 78, 57,
-        57, 78, 69
+
+// Builds a 100k node city, 1000 blocks of 9 buildings of 10 parts each,
+// and times SceneGraph::update() with every block moving (every node
+// recomputed), with 1% of them moving, and with nothing moving. The full
+// update is also timed composed the glm way, translate * mat4_cast * scale
+// and a full matrix product per node, for comparison.
+void UBenchmarkScene()
+{
+    const int BLOCKS = 1000, BUILDINGS = 9, PARTS = 10;
+    const int FRAMES = 200;
+    const double TARGET_MS = 1.0;
+    const glm::vec3 UP(0.0f, 1.0f, 0.0f);
+
+    // every node's local transform is also kept for the glm comparison
+    SceneGraph scene;
+    const size_t nodes = (size_t)BLOCKS * (1 + BUILDINGS * (1 + PARTS));
+    scene.reserve(nodes);
+    std::vector<glm::vec3> translations, scales;
+    std::vector<glm::quat> rotations;
+    auto add = [&](int parent, const glm::vec3& t, const glm::quat& r, const glm::vec3& s)
+    {
+        translations.push_back(t);
+        rotations.push_back(r);
+        scales.push_back(s);
+        return scene.addNode(parent, t, r, s);
     };
+    std::vector<int> blocks;
+    for (int b = 0; b < BLOCKS; ++b)
+    {
+        const int block = add(SceneGraph::NO_PARENT, glm::vec3((b % 32) * 20.0f, 0.0f, (b / 32) * -20.0f),
+            glm::angleAxis(0.0f, UP), glm::vec3(1.0f));
+        blocks.push_back(block);
+        for (int i = 0; i < BUILDINGS; ++i)
+        {
+            const int building = add(block, glm::vec3((i % 3) * 6.0f, 0.0f, (i / 3) * -6.0f),
+                glm::angleAxis(glm::radians(90.0f * (i % 4)), UP), glm::vec3(1.0f, 1.0f + i * 0.5f, 1.0f));
+            for (int p = 0; p < PARTS; ++p)
+                add(building, glm::vec3(0.0f, p * 0.3f, 0.0f), glm::angleAxis(p * 0.1f, UP), glm::vec3(0.9f));
+        }
+    }
+    scene.update();
+    cout << "INFO: Scene graph benchmark, " << scene.size() << " nodes, " << scene.size() * SceneGraph::nodeBytes() / (1024 * 1024)
+        << " MB, " << FRAMES << " frames per case" << endl;
+
+    float checksum = 0.0f;
+    // times FRAMES updates, moving every step-th block before each; the
+    // median keeps a preempted frame or two from deciding the result
+    auto timeUpdates = [&](const char* name, int step, bool target)
+    {
+        std::vector<double> times;
+        size_t updated = 0;
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            for (int b = step > 0 ? frame % step : BLOCKS; b < BLOCKS; b += step)
+                scene.setRotation(blocks[b], glm::angleAxis(frame * 0.01f, UP));
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            updated = scene.update();
+            times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+            checksum += scene.world((int)scene.size() - 1)[3].x;
+        }
+        std::sort(times.begin(), times.end());
+        const double median = times[times.size() / 2];
+        cout << "INFO:   " << name << ": " << updated << " nodes recomputed, " << median << " ms median, "
+            << times.front() << " ms best, " << median * 1.0e6 / scene.size() << " ns per node";
+        if (target)
+            cout << ", " << (median < TARGET_MS ? "meets" : "MISSES") << " the 1 ms target";
+        cout << endl;
+    };
+    timeUpdates("all moving", 1, true);
+    timeUpdates("1% moving", 100, false);
+    timeUpdates("none moving", 0, false);
+
+    // the same hierarchy composed with glm's general matrices, in the same
+    // parents-first order, which must give the same world matrices
+    for (int block : blocks)
+        scene.setRotation(block, rotations[block]);
+    scene.update();
+    std::vector<glm::mat4> world(nodes);
+    double total = 0.0;
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            const int parent = scene.parent((int)i);
+            const glm::mat4 local = glm::translate(translations[i]) * glm::mat4_cast(rotations[i]) * glm::scale(scales[i]);
+            world[i] = parent == SceneGraph::NO_PARENT ? local : world[parent] * local;
+        }
+        total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        checksum += world.back()[3].x;
+    }
+    float largestError = 0.0f;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            const glm::vec4 difference = world[i][column] - scene.world((int)i)[column];
+            largestError = std::max(largestError, std::max(std::max(std::fabs(difference.x), std::fabs(difference.y)),
+                std::max(std::fabs(difference.z), std::fabs(difference.w))));
+        }
+    }
+    cout << "INFO:   all moving, glm matrices: " << total / FRAMES << " ms mean, largest difference "
+        << largestError << " (checksum " << checksum << ")" << endl;
+}
 
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerColor = 4;
-    const GLuint floatsPerUV = 2;
 
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerUV);
+// Decodes every texture with stb_image's JPEG kernels limited to plain C,
+// to SSE2 and to AVX2, in each of the channel counts the loader can ask for,
+// and checks that every level gives exactly the plain C pixels. Returns
+// false on any difference.
+bool UCheckDecodeSimd()
+{
+    const char* LEVEL_NAMES[] = { "C", "SSE2", "AVX2" };
+    const int LEVELS = 3;
+    const int CHANNELS[] = { 0, 1, 3, 4 };
+    cout << "INFO: JPEG SIMD check, CPU has SSE2 " << (cpuFeatures().sse2 ? "yes" : "no")
+        << ", AVX2 " << (cpuFeatures().avx2 ? "yes" : "no") << endl;
+
+    bool matches = true;
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        MappedFile data;
+        if (!data.open(MATERIAL_FILES[i]))
+        {
+            cout << "Failed to load texture " << MATERIAL_FILES[i] << endl;
+            matches = false;
+            continue;
+        }
+
+        for (int channels : CHANNELS)
+        {
+            std::vector<unsigned char> reference;
+            std::ostringstream line;
+            line << "INFO: " << MATERIAL_FILES[i] << " req_comp " << channels << ":";
+            for (int level = 0; level < LEVELS; ++level)
+            {
+                stbi_set_jpeg_simd_level(level);
+                ImageInfo info;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                unsigned char* image = decodeImage(data.data(), data.size(), info, channels);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                if (image == nullptr)
+                {
+                    line << " " << LEVEL_NAMES[level] << " FAILED: " << info.error;
+                    matches = false;
+                    continue;
+                }
+                std::vector<unsigned char> pixels(image, image + (size_t)info.width * info.height * (channels ? channels : info.channels));
+                freeImage(image);
+                line << " " << LEVEL_NAMES[level] << " " << ms << " ms";
+                if (level == 0)
+                    reference.swap(pixels);
+                else if (pixels != reference)
+                {
+                    line << " WRONG RESULT";
+                    matches = false;
+                }
+            }
+            cout << line.str() << endl;
+        }
+    }
+    stbi_set_jpeg_simd_level(2);
+    cout << "INFO: JPEG SIMD check " << (matches ? "passed" : "FAILED") << endl;
+    return matches;
+}
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
 
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, mesh.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+// Reports what decodeImage() did so far: images, bytes in and out, time
+// summed over the decoding threads and stb_image's allocations
+void ULogDecodeStats()
+{
+    const ImageDecodeStats stats = imageDecodeStats();
+    if (stats.decoded == 0 && stats.failed == 0)
+        return;
+    cout << "INFO: Decoded " << stats.decoded << " images (" << stats.failed << " failed), "
+        << stats.inputBytes / 1024 << " KB to " << stats.outputBytes / 1024 << " KB in " << stats.decodeMs
+        << " ms of decoding; stb_image made " << stats.allocations << " mallocs and " << stats.reallocations
+        << " reallocs for " << stats.allocatedBytes / 1024 << " KB, " << stats.heapAllocations << " reached the heap";
+    if (gOptions.imageArena)
+        cout << ", largest arena " << stats.arenaPeakBytes / 1024 << " KB";
+    cout << endl;
+}
 
-    mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// Runs one of stb_image's parallel loops on the shared thread pool
+void UStbParallelFor(stbi_parallel_body* body, void* context, int count)
+{
+    sharedThreadPool().parallelFor(count, [&](int begin, int end) { body(context, begin, end); });
+}
 
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
+// Places the camera on the benchmark's scripted path: one orbit around the
+// scene per run, bobbing up and down, always looking at the scene center.
+// Depends only on the frame number so every run renders the same frames.
+void UBenchmarkCamera(int frame, int frames)
+{
+    const glm::vec3 center(0.0f, 0.0f, -14.0f);
+    const float radius = 12.0f;
 
-    glGenVertexArrays(1, &mesh2.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh2.vao);
+    float angle = 2.0f * glm::pi<float>() * frame / (float)(frames > 0 ? frames : 1);
+    glm::vec3 position = center + glm::vec3(radius * cos(angle), 3.0f + 1.5f * sin(2.0f * angle), radius * sin(angle));
+    glm::vec3 front = glm::normalize(center - position);
 
-    //Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, mesh2.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh2.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+    float yaw = glm::degrees(atan2(front.z, front.x));
+    float pitch = glm::degrees(asin(front.y));
+    gCamera = Camera(position, glm::vec3(0.0f, 1.0f, 0.0f), yaw, pitch);
+}
 
-    mesh2.nIndices = sizeof(indices2) / sizeof(indices2[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh2.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices2), indices2, GL_STATIC_DRAW);
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// Waits for the outstanding GPU timers and writes the benchmark's JSON report
+// to --benchmark-output, or to stdout without it
+bool UWriteBenchmarkReport()
+{
+    gFrameProfiler.finish();
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
 
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+    if (gOptions.benchmarkOutput.empty())
+    {
+        gFrameProfiler.writeJSON(cout, renderer);
+        return true;
+    }
+
+    std::ofstream out(gOptions.benchmarkOutput);
+    if (!out)
+    {
+        cout << "ERROR: cannot write benchmark report " << gOptions.benchmarkOutput << endl;
+        return false;
+    }
+    gFrameProfiler.writeJSON(out, renderer);
+    cout << "INFO: Benchmark report written to " << gOptions.benchmarkOutput << endl;
+    return true;
+}
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
 
+// Starts generating the meshes, normals and tangents included, on a worker
+// while the window, the shaders and the textures are set up
+void UStartMeshBuild()
+{
+    gMeshBuilder.start(UGenerateScene, gOptions.normals);
+}
 
-    glGenVertexArrays(1, &mesh3.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh3.vao);
 
-    //Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, mesh3.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh3.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+// Generates the scene's meshes: the bricks building with its three
+// battlements, the ground plane and the concrete building with its rounded
+// roof. Each mesh's storage is sized once and filled by the generators.
+void UGenerateScene(std::vector<BuiltMesh>& meshes)
+{
+    // Battlements sit on the main block, so their bottoms would never show
+    const unsigned int BATTLEMENT_FACES = BOX_ALL_FACES & ~BOX_BOTTOM;
+    const float BATTLEMENTS[3][2] = { { -0.5f, -0.3f }, { -0.1f, 0.1f }, { 0.3f, 0.5f } };
+    const float PI = glm::pi<float>();
+
+    meshes.resize(3);
+    GeometryCounts counts[3] = { boxCounts(), quadCounts(), boxCounts(BOX_WALLS) };
+    for (int i = 0; i < 3; ++i)
+        counts[0] += boxCounts(BATTLEMENT_FACES);
+    counts[2] += arcCounts(ROOF_SEGMENTS);
+    std::vector<GeometryBuffer> buffers;
+    for (int i = 0; i < 3; ++i)
+    {
+        meshes[i].vertices.resize(counts[i].vertices);
+        meshes[i].indices.resize(counts[i].indices);
+        buffers.emplace_back(meshes[i].vertices.data(), counts[i].vertices, meshes[i].indices.data(), counts[i].indices);
+    }
 
-    mesh3.nIndices = sizeof(indices3) / sizeof(indices3[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh3.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices3), indices3, GL_STATIC_DRAW);
+    // Buildings: a unit cube with three battlements along its top
+    addBox(buffers[0], glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f), 10.0f);
+    for (const float* battlement : BATTLEMENTS)
+        addBox(buffers[0], glm::vec3(battlement[0], 0.5f, -0.5f), glm::vec3(battlement[1], 0.7f, 0.5f), 10.0f, BATTLEMENT_FACES);
+
+    // Ground plane, grass repeated 5 times each way
+    addQuad(buffers[1], glm::vec3(-5.0f, -0.5f, 5.0f), glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -10.0f), 5.0f, 5.0f);
+
+    // Second building: four walls under a half round roof
+    addBox(buffers[2], glm::vec3(-3.5f, -0.5f, -0.5f), glm::vec3(-2.5f, -0.1f, 1.0f), 5.0f, BOX_WALLS);
+    addArc(buffers[2], glm::vec3(-3.0f, -0.1f, -0.5f), 0.5f, 0.0f, PI, 1.5f, ROOF_SEGMENTS, 5.0f);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        meshes[i].vertices.resize(buffers[i].vertexCount);
+        meshes[i].indices.resize(buffers[i].indexCount);
+        // Sampling at -v with GL_REPEAT is sampling at 1 - v, i.e. the image
+        // flipped, so the textures can be uploaded without flipping their rows
+        if (gOptions.textureFlip == FLIP_UV)
+        {
+            for (SourceVertex& vertex : meshes[i].vertices)
+                vertex.uv[1] = -vertex.uv[1];
+        }
+    }
+}
+
+
+// Uploads the meshes UStartMeshBuild() built, each with its own vertices
+// since the normals of a vertex depend on the faces around it
+void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    std::vector<BuiltMesh>& built = gMeshBuilder.wait();
+    chrono::duration<double, milli> waited = chrono::steady_clock::now() - start;
+    const char* normals[] = { "generated", "flat", "smooth" };
+    cout << "INFO: Built " << built.size() << " meshes with " << normals[gOptions.normals]
+        << " normals and tangents in " << gMeshBuilder.buildMs() << " ms on a worker, waited " << waited.count() << " ms" << endl;
+
+    // Only what the lighting shader reads is stored: positions, normals and
+    // texture coordinates. Tangents are there for normal mapped shaders.
+    const bool used[VERTEX_ATTRIBUTE_COUNT] = { true, true, false, true, false };
+    gVertexFormat = gOptions.compactVertices ? VertexFormat::compact(used) : VertexFormat::full(used);
+
+    gMeshArena.setStride(gVertexFormat.stride());
+    GLMesh* meshes[] = { &mesh, &mesh2, &mesh3 };
+    std::vector<unsigned char> packed;
+    for (size_t i = 0; i < built.size(); ++i)
+    {
+        packed.clear();
+        gVertexFormat.pack(built[i].vertices.data(), built[i].vertices.size(), packed);
+        GLint baseVertex = gMeshArena.addVertices(packed.data(), (GLuint)built[i].vertices.size());
+        *meshes[i] = gMeshArena.addMesh(baseVertex, built[i].indices.data(), (GLuint)built[i].indices.size());
+    }
+
+    // Sends vertex and index data to the GPU, leaving the arena's VAO bound
+    gMeshArena.upload();
 
     // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+    gVertexFormat.apply();
 
-    glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerColor)));
-    glEnableVertexAttribArray(2);
+    cout << "INFO: Mesh buffers: " << gMeshArena.vertexBytes() + gMeshArena.indexBytes() << " bytes ("
+        << gMeshArena.vertexBytes() << " vertex, " << gMeshArena.indexBytes() << " index)" << endl;
+    cout << "INFO: Vertex format: " << gVertexFormat.describe() << endl;
+    const char* names[] = { "buildings", "ground", "second building" };
+    for (size_t i = 0; i < built.size(); ++i)
+        UReportMeshBandwidth(names[i], built[i], gVertexFormat.stride());
 }
 
 
-void UDestroyMesh(GLMesh& mesh)
+// Logs the vertex data a mesh takes and what one draw of it fetches, at
+// stride bytes per vertex and at the LEGACY_VERTEX_SIZE vertices used to
+// take. Fetches count every index, as if the post-transform cache never hit.
+void UReportMeshBandwidth(const char* name, const BuiltMesh& mesh, GLsizei stride)
 {
-    glDeleteVertexArrays(1, &mesh.vao);
-    glDeleteBuffers(2, mesh.vbos);
+    const size_t vertices = mesh.vertices.size();
+    const size_t count = mesh.indices.size();
+    cout << "INFO: Mesh " << name << ": " << count / 3 << " triangles, " << vertices << " vertices of "
+        << stride << " bytes = " << vertices * stride << " bytes (" << vertices * LEGACY_VERTEX_SIZE << " before), "
+        << count * stride << " bytes fetched per draw (" << count * LEGACY_VERTEX_SIZE << " before)" << endl;
+}
+
+
+// Checks the vertex layout against the inputs of the program the meshes are
+// drawn with, so a shader reading an attribute nothing feeds is reported
+// before the first frame instead of rendering garbage
+bool UCheckVertexLayout(const Shader& shader, const char* name)
+{
+    std::vector<std::string> errors, warnings;
+    const std::vector<GLuint> otherLocations = { MATERIAL_ATTRIBUTE, INSTANCE_TRANSFORM_ATTRIBUTE };
+    gVertexFormat.check(shader.ID, otherLocations, errors, warnings);
+    for (const std::string& warning : warnings)
+        cout << "WARNING: " << name << ": " << warning << endl;
+    for (const std::string& error : errors)
+        cout << "ERROR: " << name << ": " << error << endl;
+    return errors.empty();
+}
+
+
+void UDestroyMesh()
+{
+    gMeshArena.destroy();
+}
+
+
+// Builds the scene's transform hierarchy: the root every mesh is drawn
+// under and, with --stress-instances, a grid of buildings behind the scene,
+// one node per row, a node per building under it, and a node placing the
+// building's mesh under that
+void UCreateScene()
+{
+    // 1. Scales the object by 2
+    const glm::vec3 scale(2.0f, 2.0f, 2.0f);
+    // 2. Rotates shape by 15 (radians) about the y axis
+    const glm::quat rotation = glm::angleAxis(15.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+    // 3. Moves it in front of the camera
+    const glm::vec3 translation(0.0f, 0.0f, -14.0f);
+    gSceneRoot = gScene.addNode(SceneGraph::NO_PARENT, translation, rotation, scale);
+
+    if (gOptions.stressInstances <= 0)
+        return;
+
+    // The stress buildings are instances drawn under the root's model
+    // matrix, so their nodes hang from a root of their own: its space is the
+    // scene root's. Alternate cells get the bricks building and the concrete
+    // one, the latter moved from where UGenerateScene() put it to the cell's
+    // center, and both turn a quarter more every few cells.
+    const int columns = (int)std::ceil(std::sqrt((double)gOptions.stressInstances));
+    const glm::vec3 concreteOffset(3.0f, 0.0f, -0.25f);
+    gScene.reserve(2 + (size_t)gOptions.stressInstances * 2 + gOptions.stressInstances / columns + 1);
+    const int district = gScene.addNode(SceneGraph::NO_PARENT);
+    int row = SceneGraph::NO_PARENT;
+    for (int i = 0; i < gOptions.stressInstances; ++i)
+    {
+        const int column = i % columns;
+        if (column == 0)
+            row = gScene.addNode(district, glm::vec3(0.0f, 0.0f, -8.0f - (i / columns) * STRESS_SPACING));
+        const int kind = (column + i / columns) & 1;
+        const int building = gScene.addNode(row, glm::vec3((column - columns / 2) * STRESS_SPACING, 0.0f, 0.0f),
+            glm::angleAxis(glm::radians(90.0f * (i / 3 % 4)), glm::vec3(0.0f, 1.0f, 0.0f)));
+        gStressNodes[kind].push_back(gScene.addNode(building, kind == 0 ? glm::vec3(0.0f) : concreteOffset));
+    }
+    cout << "INFO: Scene graph: " << gScene.size() << " nodes, " << gScene.size() * SceneGraph::nodeBytes() << " bytes" << endl;
+    gScene.update();
+}
+
+
+// Queues every mesh with the index of its material (the layer of its
+// diffuse map) so the whole scene is one glMultiDrawElementsIndirect. With
+// --stress-instances the two buildings are repeated on the grid
+// UCreateScene() placed, each mesh uploaded once and drawn once per instance.
+void UCreateDrawBatch()
+{
+    gDrawBatch.add(gMesh, 0);   // buildings: bricks
+    gDrawBatch.add(gMesh2, 1);  // ground plane: grass
+    gDrawBatch.add(gMesh3, 2);  // second building: concrete
+
+    // every stress building's transform is its mesh node's world matrix
+    gNodeInstances.assign(gScene.size(), -1);
+    for (int kind = 0; kind < 2; ++kind)
+    {
+        std::vector<DrawInstance> instances;
+        instances.reserve(gStressNodes[kind].size());
+        for (int node : gStressNodes[kind])
+        {
+            DrawInstance instance;
+            instance.transform = gScene.world(node);
+            instance.material = kind == 0 ? 0 : 2;
+            instances.push_back(instance);
+        }
+        const GLuint first = gDrawBatch.add(kind == 0 ? gMesh : gMesh3, instances.data(), (GLuint)instances.size());
+        for (size_t i = 0; i < gStressNodes[kind].size(); ++i)
+            gNodeInstances[gStressNodes[kind][i]] = (int)(first + i);
+    }
+
+    gMeshArena.bind();
+    gDrawBatch.upload(MATERIAL_ATTRIBUTE, INSTANCE_TRANSFORM_ATTRIBUTE);
+    glBindVertexArray(0);
+    cout << "INFO: Draw batch: " << gDrawBatch.drawCount() << " draws, " << gDrawBatch.instanceCount()
+        << " instances, " << gDrawBatch.triangleCount() << " triangles, drawn "
+        << (gOptions.drawInstanced ? "with glDrawElementsInstanced per mesh" : "with one multi-draw") << endl;
+}
+
+
+// Copies the world matrix of every node the last scene update moved into
+// the draw batch instance it is drawn as, and uploads the changed records
+void UUpdateDrawBatch()
+{
+    for (int node : gMovedNodes)
+    {
+        if (node < (int)gNodeInstances.size() && gNodeInstances[node] >= 0)
+            gDrawBatch.setTransform((GLuint)gNodeInstances[node], gScene.world(node));
+    }
+    gDrawBatch.updateInstances();
 }
 
 
@@ -882,48 +1796,565 @@ void UDestroyShaderProgram(GLuint programId)
     glDeleteProgram(programId);
 }
 
-bool UCreateTexture(const char* filename, GLuint& textureId)
+// Runs on the loader threads: turns a decoded texture the right way up and
+// resamples it to the size of a material layer
+void UPrepareTexture(DecodedImage& image)
+{
+    if (gOptions.textureFlip == FLIP_ROWS)
+        flipImageVertically(image.pixels, image.width, image.height, image.channels);
+    if (image.width != gLayerSize || image.height != gLayerSize)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        std::vector<unsigned char> resampled((size_t)gLayerSize * gLayerSize * image.channels);
+        MaterialArray::resample(image.pixels, image.width, image.height, image.channels,
+            resampled.data(), gLayerSize, gLayerSize, gOptions.resampleFilter);
+
+        // Sources larger than a layer would have cost this much more at full size
+        size_t sourceBytes = MaterialArray::storageBytes(gTextureFormat, image.width, image.height, 1);
+        size_t layerBytes = MaterialArray::storageBytes(gTextureFormat, gLayerSize, gLayerSize, 1);
+        if (sourceBytes > layerBytes)
+        {
+            gTextureBytesSaved += sourceBytes - layerBytes;
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+            std::ostringstream report;
+            report << "INFO: Downsampled " << image.path << " from " << image.width << "x" << image.height << " to "
+                << gLayerSize << "x" << gLayerSize << " in " << elapsed.count() << " ms, "
+                << (sourceBytes - layerBytes) / 1024 << " KB less texture memory\n";
+            cout << report.str() << flush;
+        }
+        image.replace(std::move(resampled), gLayerSize, gLayerSize);
+    }
+    // Compressed arrays cannot build their own mip chains, so every level is
+    // prepared and compressed here; so is every texture that goes into the cache
+    const uint64_t cacheKey = image.index < (int)gTextureCacheKeys.size() ? gTextureCacheKeys[image.index] : 0;
+    const bool cache = cacheKey != 0 && (image.channels == 3 || image.channels == 4);
+    BlockFormat block;
+    if (UBlockFormat(gTextureFormat, block) || cache)
+        UBuildTextureLevels(image, gTextureFormat);
+    if (!cache)
+        return;
+
+    BakedTextureHeader header = {};
+    if (UBlockFormat(gTextureFormat, block))
+        header.internalFormat = gTextureFormat;
+    else
+        header.internalFormat = image.channels == 4 ? GL_RGBA8 : GL_RGB8;
+    header.width = image.width;
+    header.height = image.height;
+    header.flags = gOptions.textureFlip == FLIP_UV ? 0 : BAKED_TEXTURE_FLIPPED;
+    fileStamp(image.path.c_str(), header.sourceSize, header.sourceTime);
+    std::ostringstream report;
+    if (gTextureCache.store(cacheKey, header, image.levels))
+        report << "INFO: Cached " << image.path << " as " << gTextureCache.path(cacheKey) << "\n";
+    else
+        report << "WARNING: cannot write " << gTextureCache.path(cacheKey) << "\n";
+    cout << report.str() << flush;
+}
+
+
+// GL internal format for a compression choice
+GLenum UCompressionFormat(TextureCompression compression)
+{
+    switch (compression)
+    {
+    case COMPRESS_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case COMPRESS_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return GL_RGB8;
+    }
+}
+
+
+// Block format of a compressed GL internal format, false for uncompressed ones
+bool UBlockFormat(GLenum format, BlockFormat& block)
 {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
+    switch (format)
     {
-        flipImageVertically(image, width, height, channels);
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: block = BLOCK_BC1; return true;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: block = BLOCK_BC7; return true;
+    default: return false;
+    }
+}
 
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
 
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+const char* UTextureFormatName(GLenum format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+    case GL_RGBA8: return "RGBA8";
+    default: return "RGB8";
+    }
+}
 
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+
+// Whether the context can sample textures of an internal format; S3TC is an
+// extension everywhere, BPTC is core since GL 4.2
+bool UTextureFormatSupported(GLenum format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return glewIsSupported("GL_EXT_texture_compression_s3tc") == GL_TRUE;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return glewIsSupported("GL_VERSION_4_2") == GL_TRUE || glewIsSupported("GL_ARB_texture_compression_bptc") == GL_TRUE;
+    default:
+        return true;
+    }
+}
+
+
+// Builds the whole mip chain of a prepared image into image.levels and, for
+// a compressed format, compresses every level; reports the compression's
+// throughput and its PSNR against the uncompressed top level
+void UBuildTextureLevels(DecodedImage& image, GLenum format)
+{
+    std::vector<std::vector<unsigned char> >& levels = image.levels;
+    levels.assign(1, std::vector<unsigned char>(image.pixels, image.pixels + (size_t)image.width * image.height * image.channels));
+    buildMipChain(levels, image.width, image.height, image.channels);
+
+    BlockFormat block;
+    if (!UBlockFormat(format, block))
+        return;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t pixels = 0;
+    double psnr = 0.0;
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        int width = image.width >> level > 0 ? image.width >> level : 1;
+        int height = image.height >> level > 0 ? image.height >> level : 1;
+        std::vector<unsigned char> blocks(compressedSize(block, width, height));
+        compressImage(block, levels[level].data(), width, height, image.channels, blocks.data());
+        pixels += (size_t)width * height;
+        if (level == 0)
+        {
+            std::vector<unsigned char> decoded((size_t)width * height * 3);
+            decompressImage(block, blocks.data(), width, height, decoded.data());
+            psnr = psnrRGB(levels[0].data(), image.channels, decoded.data(), 3, width, height);
+        }
+        levels[level].swap(blocks);
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+    // one write, the loader threads report concurrently
+    std::ostringstream report;
+    report << "INFO: Compressed " << image.path << " to " << UTextureFormatName(format) << ": "
+        << levels.size() << " levels in " << elapsed.count() << " ms ("
+        << pixels / (elapsed.count() * 1000.0) << " Mpixels/s), PSNR " << psnr << " dB\n";
+    cout << report.str() << flush;
+}
+
+
+// Where --bake stores the baked form of a texture
+std::string UBakedTexturePath(const char* source)
+{
+    return std::string(source) + ".mtex";
+}
+
+
+// Cache key of a material texture: its source bytes, and everything that
+// decides how UPrepareTexture turns them into levels
+uint64_t UTextureCacheKey(const MappedFile& source)
+{
+    const uint64_t options[] = {
+        TEXTURE_CACHE_VERSION,
+        (uint64_t)gTextureFormat,
+        (uint64_t)gLayerSize,
+        (uint64_t)(gOptions.textureFlip == FLIP_UV),
+        (uint64_t)gOptions.resampleFilter,
+    };
+    uint64_t key = textureContentHash(source.data(), source.size(), textureContentHash(options, sizeof(options)));
+    // 0 stands for "not cached"
+    return key != 0 ? key : 1;
+}
+
+
+// Uploads a material's baked texture, every mip level straight from the
+// mapped file. Compressed bakes go into an uncompressed array by decoding
+// their blocks on the CPU, for contexts without the compressed format.
+// Returns false if there is no usable baked file, in which case the source
+// image has to be decoded.
+bool UUploadBakedTexture(int material, PixelUploadRing& staging)
+{
+    // Baked rows are flipped already; negated texture coordinates would flip them back
+    if (gOptions.textureFlip == FLIP_UV)
+        return false;
+
+    const std::string path = UBakedTexturePath(MATERIAL_FILES[material]);
+    BakedTexture baked;
+    if (!baked.open(path.c_str()))
+        return false;
+
+    if (!baked.matchesSource(MATERIAL_FILES[material]))
+    {
+        cout << "INFO: " << path << " is older than its source, run --bake again" << endl;
+        return false;
+    }
+    return UUploadBakedLevels(material, baked, path, ", run --bake again", staging);
+}
+
+
+// Uploads every level of a baked texture or texture cache entry into a
+// material's layer, if it fits the array; remedy ends the message if not
+bool UUploadBakedLevels(int material, const BakedTexture& baked, const std::string& path, const char* remedy, PixelUploadRing& staging)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    const BakedTextureHeader& header = baked.header();
+    const int channels = header.internalFormat == GL_RGBA8 ? 4 : 3;
+    BlockFormat block = BLOCK_BC1;
+    const bool compressed = UBlockFormat(header.internalFormat, block);
+    const bool decompress = compressed && !gMaterials.compressed();
+    if ((!compressed && header.internalFormat != GL_RGB8 && header.internalFormat != GL_RGBA8)
+        || (!decompress && (compressed || gMaterials.compressed()) && header.internalFormat != gMaterials.internalFormat())
+        || header.width != (uint32_t)gMaterials.layerWidth() || header.height != (uint32_t)gMaterials.layerHeight()
+        || header.levels != (uint32_t)gMaterials.levelCount())
+    {
+        cout << "INFO: " << path << " does not fit the material array" << remedy << endl;
+        return false;
+    }
+
+    staging.resetWaitMs();
+    size_t bytes = 0;
+    std::vector<unsigned char> decoded;
+    for (uint32_t level = 0; level < header.levels; ++level)
+    {
+        const uint32_t width = baked.levelWidth(level);
+        const uint32_t height = baked.levelHeight(level);
+        bool uploaded;
+        if (decompress)
+        {
+            uploaded = baked.levelSize(level) == compressedSize(block, width, height);
+            if (uploaded)
+            {
+                decoded.resize((size_t)width * height * 3);
+                decompressImage(block, baked.levelData(level), width, height, decoded.data());
+                uploaded = gMaterials.uploadLevel(material, level, decoded.data(), 3, &staging);
+            }
+        }
+        else if (compressed)
+        {
+            uploaded = gMaterials.uploadCompressedLevel(material, level, baked.levelData(level), baked.levelSize(level), &staging);
+        }
         else
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
+            uploaded = baked.levelSize(level) == (size_t)width * height * channels
+                && gMaterials.uploadLevel(material, level, baked.levelData(level), channels, &staging);
+        }
+        if (!uploaded)
+        {
+            cout << "WARNING: " << path << " is damaged at level " << level << endl;
             return false;
         }
+        bytes += baked.levelSize(level);
+    }
+    chrono::duration<double, milli> upload = chrono::steady_clock::now() - start;
+    cout << "INFO: Uploaded " << path << " (" << UTextureFormatName(header.internalFormat)
+        << (decompress ? " decoded on the CPU, " : ", ") << bytes / 1024 << " KB, " << header.levels << " levels) in "
+        << upload.count() << " ms, " << staging.waitMs() << " ms waiting for staging slots" << endl;
+    return true;
+}
 
-        glGenerateMipmap(GL_TEXTURE_2D);
 
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+// Picks the internal format of the material array: the one asked for with
+// --compress, or without it the one the textures were baked in. Compressed
+// formats the context cannot sample fall back to GL_RGB8.
+GLenum UChooseTextureFormat()
+{
+    GLenum format = UCompressionFormat(gOptions.compression);
+    BlockFormat block;
+    if (gOptions.compression == COMPRESS_AUTO && gOptions.textureFlip != FLIP_UV)
+    {
+        BakedTexture baked;
+        if (baked.open(UBakedTexturePath(MATERIAL_FILES[0]).c_str()) && UBlockFormat(baked.header().internalFormat, block))
+            format = baked.header().internalFormat;
+    }
+    if (!UTextureFormatSupported(format))
+    {
+        cout << "WARNING: " << UTextureFormatName(format) << " textures are not supported, storing them as "
+            << UTextureFormatName(GL_RGB8) << endl;
+        format = GL_RGB8;
+    }
+    return format;
+}
 
-        return true;
+
+// Size of a material layer in a format: MATERIAL_LAYER_SIZE, halved until
+// it is within maxSize (the context's limit, 0 for none) and
+// --max-texture-size, and until the whole array fits in --texture-budget
+GLsizei UChooseLayerSize(GLenum format, GLint maxSize)
+{
+    if (gOptions.maxTextureSize > 0 && (maxSize == 0 || gOptions.maxTextureSize < maxSize))
+        maxSize = gOptions.maxTextureSize;
+
+    GLsizei size = MATERIAL_LAYER_SIZE;
+    const size_t budget = (size_t)gOptions.textureBudget * 1024 * 1024;
+    while (size > 1 && ((maxSize > 0 && size > maxSize)
+        || (budget > 0 && MaterialArray::storageBytes(format, size, size, MATERIAL_COUNT) > budget)))
+    {
+        size /= 2;
+    }
+    if (size != MATERIAL_LAYER_SIZE)
+    {
+        cout << "INFO: Material layers limited to " << size << "x" << size << " ("
+            << MaterialArray::storageBytes(format, size, size, MATERIAL_COUNT) / 1024 << " KB instead of "
+            << MaterialArray::storageBytes(format, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, MATERIAL_COUNT) / 1024 << " KB)" << endl;
+    }
+    return size;
+}
+
+
+// Opens the --texture-cache directory. --clear-texture-cache empties it
+// first, so the textures load as they would the first time.
+void UOpenTextureCache()
+{
+    if (gOptions.textureCache.empty())
+        return;
+    const uint64_t maxBytes = gOptions.textureCacheSize > 0 ? (uint64_t)gOptions.textureCacheSize * 1024 * 1024 : 0;
+    if (!gTextureCache.open(gOptions.textureCache.c_str(), maxBytes))
+    {
+        cout << "WARNING: cannot use " << gOptions.textureCache << " as the texture cache" << endl;
+        return;
+    }
+    if (gOptions.clearTextureCache)
+        cout << "INFO: Deleted " << gTextureCache.clear() << " texture cache entries" << endl;
+}
+
+
+// Fills every layer of the material array. Baked textures and texture cache
+// entries are uploaded as they are; the others are decoded in parallel and
+// each one is uploaded into its layer as soon as it is ready. Workers also
+// flip, resample and, for a compressed array or the cache, build the mip
+// chain, so the GL thread does nothing but the uploads.
+bool UCreateTextures()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    gTextureBytesSaved = 0;
+    gTextureFormat = UChooseTextureFormat();
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    gLayerSize = UChooseLayerSize(gTextureFormat, maxTextureSize);
+    gMaterials.create(gLayerSize, gLayerSize, MATERIAL_COUNT, gTextureFormat);
+
+    PixelUploadRing staging;
+    if (!staging.create(TEXTURE_STAGING_SLOT_SIZE, TEXTURE_STAGING_SLOTS))
+        return false;
+
+    std::vector<const char*> decodeFiles;
+    std::vector<int> decodeLayers;
+    gTextureCacheKeys.clear();
+    int baked = 0;
+    int cached = 0;
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        if (UUploadBakedTexture(i, staging))
+        {
+            ++baked;
+            continue;
+        }
+        uint64_t key = 0;
+        MappedFile source;
+        if (gTextureCache.enabled() && source.open(MATERIAL_FILES[i]))
+        {
+            key = UTextureCacheKey(source);
+            BakedTexture entry;
+            if (gTextureCache.lookup(key, entry)
+                && UUploadBakedLevels(i, entry, gTextureCache.path(key), ", decoding it again", staging))
+            {
+                ++cached;
+                continue;
+            }
+        }
+        decodeFiles.push_back(MATERIAL_FILES[i]);
+        decodeLayers.push_back(i);
+        gTextureCacheKeys.push_back(key);
+    }
+
+    // With FLIP_UV nothing is flipped here, UGenerateScene() negates V instead
+    stbi_set_flip_vertically_on_load(gOptions.textureFlip == FLIP_STB);
+
+    TextureLoader loader;
+    loader.start(decodeFiles.data(), (int)decodeFiles.size(), UPrepareTexture);
+
+    bool loaded = true;
+    bool needMipmaps = false;
+    DecodedImage image;
+    while (loader.next(image))
+    {
+        // Error loading the image
+        if (image.pixels == nullptr)
+        {
+            cout << "Failed to load texture " << image.path << ": " << image.error << endl;
+            loaded = false;
+            continue;
+        }
+
+        chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+        staging.resetWaitMs();
+        bool uploaded = true;
+        size_t bytes = 0;
+        if (!image.levels.empty())
+        {
+            for (size_t level = 0; uploaded && level < image.levels.size(); ++level)
+            {
+                if (gMaterials.compressed())
+                {
+                    uploaded = gMaterials.uploadCompressedLevel(decodeLayers[image.index], (GLint)level,
+                        image.levels[level].data(), image.levels[level].size(), &staging);
+                }
+                else
+                {
+                    uploaded = gMaterials.uploadLevel(decodeLayers[image.index], (GLint)level,
+                        image.levels[level].data(), image.channels, &staging);
+                }
+                bytes += image.levels[level].size();
+            }
+        }
+        else
+        {
+            uploaded = gMaterials.upload(decodeLayers[image.index], image.pixels, image.width, image.height, image.channels, &staging) >= 0;
+            bytes = (size_t)image.width * image.height * image.channels;
+            needMipmaps = true;
+        }
+        if (!uploaded)
+        {
+            cout << "Failed to upload texture " << image.path << endl;
+            loaded = false;
+            continue;
+        }
+        chrono::duration<double, milli> upload = chrono::steady_clock::now() - uploadStart;
+        cout << "INFO: Uploaded " << image.path << " (" << bytes / 1024 << " KB) in "
+            << upload.count() << " ms, " << staging.waitMs() << " ms waiting for staging slots" << endl;
     }
+    // The GPU may still be reading the last slots; GL frees the buffer once it is done
+    staging.destroy();
+    if (!loaded)
+        return false;
+    // Layers decoded without the cache only have level 0; this rebuilds the
+    // other layers' chains too, the same way they were built. Compressed
+    // layers arrive complete.
+    if (needMipmaps)
+        gMaterials.generateMipmaps();
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    gTexturesMs = elapsed.count();
+    // "baked" when no texture went near the cache
+    if (baked == MATERIAL_COUNT)
+        gTextureCacheState = "baked";
+    else if (!gTextureCache.enabled())
+        gTextureCacheState = "off";
+    else if (cached == 0)
+        gTextureCacheState = "cold";
+    else
+        gTextureCacheState = cached + baked == MATERIAL_COUNT ? "warm" : "partial";
+    cout << "INFO: Loaded " << MATERIAL_COUNT << " textures (" << baked << " baked, " << cached << " cached) in "
+        << elapsed.count() << " ms, " << UTextureFormatName(gMaterials.internalFormat()) << " array of "
+        << gMaterials.memoryBytes() / 1024 << " KB, " << gTextureBytesSaved / 1024 << " KB saved by downsampling" << endl;
+    ULogDecodeStats();
+    return true;
+}
+
 
-    // Error loading the image
-    return false;
+// Loads the material textures twice more for the benchmark report: with the
+// texture cache bypassed, decoding every source the way a first run does,
+// then from the cache this run's startup filled, since the startup itself
+// only measures whichever of the two the cache allowed. Baked textures load
+// the same way both times.
+void UBenchmarkTextureLoads()
+{
+    if (!gTextureCache.enabled() || strcmp(gTextureCacheState, "baked") == 0)
+        return;
+    const double texturesMs = gTexturesMs;
+    const char* state = gTextureCacheState;
+    const TextureCache cache = gTextureCache;
+
+    gTextureCache.close();
+    gMaterials.destroy();
+    const bool cold = UCreateTextures();
+    const double coldMs = gTexturesMs;
+
+    gTextureCache = cache;
+    gMaterials.destroy();
+    const bool warm = UCreateTextures();
+    const double warmMs = gTexturesMs;
+
+    if (cold && warm)
+    {
+        cout << "INFO: Texture loads: " << coldMs << " ms without the cache, " << warmMs << " ms from it ("
+            << gTextureCacheState << ")" << endl;
+        gFrameProfiler.setTextureLoads(coldMs, warmMs);
+    }
+    else
+        cout << "WARNING: cannot reload the textures, the report has no cold and warm texture loads" << endl;
+    gTexturesMs = texturesMs;
+    gTextureCacheState = state;
 }
 
 
-void UDestroyTexture(GLuint textureId)
+// Decodes every material texture and writes it next to its source as a
+// baked texture: flipped, resampled to the layer size, with its whole mip
+// chain, so later runs skip decoding and mipmap generation entirely. With
+// --compress bc1|bc7 the levels are stored compressed.
+bool UBakeTextures()
 {
-    glGenTextures(1, &textureId);
-}
\ No newline at end of file
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    // Baked textures are always stored bottom row first
+    gOptions.textureFlip = FLIP_ROWS;
+    gTextureFormat = UCompressionFormat(gOptions.compression);
+    gLayerSize = UChooseLayerSize(gTextureFormat, 0);
+    stbi_set_flip_vertically_on_load(0);
+
+    TextureLoader loader;
+    loader.start(MATERIAL_FILES, MATERIAL_COUNT, UPrepareTexture);
+
+    bool baked = true;
+    DecodedImage image;
+    while (loader.next(image))
+    {
+        if (image.pixels == nullptr)
+        {
+            cout << "Failed to load texture " << image.path << ": " << image.error << endl;
+            baked = false;
+            continue;
+        }
+
+        // Compressed levels are built by UPrepareTexture already
+        if (image.levels.empty())
+            UBuildTextureLevels(image, gTextureFormat);
+
+        BakedTextureHeader header = {};
+        BlockFormat block;
+        if (UBlockFormat(gTextureFormat, block))
+            header.internalFormat = gTextureFormat;
+        else
+            header.internalFormat = image.channels == 4 ? GL_RGBA8 : GL_RGB8;
+        header.width = image.width;
+        header.height = image.height;
+        header.flags = BAKED_TEXTURE_FLIPPED;
+        fileStamp(image.path.c_str(), header.sourceSize, header.sourceTime);
+
+        const std::string path = UBakedTexturePath(image.path.c_str());
+        if (!writeBakedTexture(path.c_str(), header, image.levels))
+        {
+            cout << "ERROR: cannot write " << path << endl;
+            baked = false;
+            continue;
+        }
+        size_t bytes = 0;
+        for (const std::vector<unsigned char>& level : image.levels)
+            bytes += level.size();
+        cout << "INFO: Baked " << path << ": " << image.width << "x" << image.height << " "
+            << UTextureFormatName(header.internalFormat) << ", " << image.levels.size() << " levels, " << bytes / 1024 << " KB" << endl;
+    }
+
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << "INFO: Baked " << MATERIAL_COUNT << " textures in " << elapsed.count() << " ms" << endl;
+    ULogDecodeStats();
+    return baked;
+}
+
+
+void UDestroyTexture()
+{
+    gMaterials.destroy();
+}
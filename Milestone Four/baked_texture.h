@@ -0,0 +1,176 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+
+#include <mapped_file.h>
+
+// Container for a texture baked offline: every mip level, already flipped to
+// GL's bottom-up row order and ready to upload as is. Layout, little-endian:
+//   BakedTextureHeader
+//   BakedLevel[levels]      where each level's bytes are in the file
+//   level data              each level 16-byte aligned, largest first
+const char BAKED_TEXTURE_MAGIC[4] = { 'M', 'T', 'E', 'X' };
+const uint32_t BAKED_TEXTURE_VERSION = 2;
+const uint32_t BAKED_TEXTURE_FLIPPED = 1;   // rows are stored bottom row first
+
+struct BakedTextureHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t internalFormat;    // GL internal format of every level
+    uint32_t width;             // of level 0
+    uint32_t height;
+    uint32_t levels;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t sourceSize;        // size and modification time of the image it
+    int64_t sourceTime;         // was baked from, to notice when it changes
+    uint64_t contentKey;        // TextureCache key of an entry, 0 for a baked file
+};
+
+struct BakedLevel
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+// size and modification time of a file, false if it does not exist
+inline bool fileStamp(const char* path, uint64_t& size, int64_t& time)
+{
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+    size = (uint64_t)info.st_size;
+    time = (int64_t)info.st_mtime;
+    return true;
+}
+
+// A baked texture file mapped into memory; level data points into the mapping
+class BakedTexture
+{
+public:
+    BakedTexture() : mHeader(nullptr), mLevels(nullptr)
+    {
+    }
+
+    // maps and validates path, false if it is missing or not a baked texture
+    // ------------------------------------------------------------------------
+    bool open(const char* path)
+    {
+        mHeader = nullptr;
+        mLevels = nullptr;
+        if (!mFile.open(path) || mFile.size() < sizeof(BakedTextureHeader))
+            return false;
+
+        const BakedTextureHeader* header = reinterpret_cast<const BakedTextureHeader*>(mFile.data());
+        if (memcmp(header->magic, BAKED_TEXTURE_MAGIC, sizeof(header->magic)) != 0 || header->version != BAKED_TEXTURE_VERSION)
+            return false;
+        size_t tableEnd = sizeof(BakedTextureHeader) + (size_t)header->levels * sizeof(BakedLevel);
+        if (header->levels == 0 || header->levels > 32 || tableEnd > mFile.size())
+            return false;
+
+        const BakedLevel* levels = reinterpret_cast<const BakedLevel*>(mFile.data() + sizeof(BakedTextureHeader));
+        for (uint32_t i = 0; i < header->levels; ++i)
+        {
+            if (levels[i].offset < tableEnd || levels[i].size > mFile.size() || levels[i].offset > mFile.size() - levels[i].size)
+                return false;
+        }
+        mHeader = header;
+        mLevels = levels;
+        return true;
+    }
+
+    // whether the file was baked from the source as it is now on disk
+    // ------------------------------------------------------------------------
+    bool matchesSource(const char* sourcePath) const
+    {
+        uint64_t size;
+        int64_t time;
+        return mHeader != nullptr && fileStamp(sourcePath, size, time)
+            && size == mHeader->sourceSize && time == mHeader->sourceTime;
+    }
+
+    const BakedTextureHeader& header() const { return *mHeader; }
+    const unsigned char* levelData(uint32_t level) const { return mFile.data() + mLevels[level].offset; }
+    size_t levelSize(uint32_t level) const { return (size_t)mLevels[level].size; }
+    uint32_t levelWidth(uint32_t level) const { return mHeader->width >> level ? mHeader->width >> level : 1; }
+    uint32_t levelHeight(uint32_t level) const { return mHeader->height >> level ? mHeader->height >> level : 1; }
+
+private:
+    MappedFile mFile;
+    const BakedTextureHeader* mHeader;
+    const BakedLevel* mLevels;
+};
+
+// Writes a baked texture whose levels are given largest first
+// ----------------------------------------------------------------------------
+inline bool writeBakedTexture(const char* path, BakedTextureHeader header, const std::vector<std::vector<unsigned char> >& levels)
+{
+    memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = BAKED_TEXTURE_VERSION;
+    header.levels = (uint32_t)levels.size();
+
+    std::vector<BakedLevel> table(levels.size());
+    uint64_t offset = sizeof(BakedTextureHeader) + table.size() * sizeof(BakedLevel);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        offset = (offset + 15) & ~(uint64_t)15;
+        table[i].offset = offset;
+        table[i].size = levels[i].size();
+        offset += levels[i].size();
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(table.data(), sizeof(BakedLevel), table.size(), file) == table.size();
+    static const unsigned char padding[16] = {};
+    uint64_t position = sizeof(BakedTextureHeader) + table.size() * sizeof(BakedLevel);
+    for (size_t i = 0; written && i < levels.size(); ++i)
+    {
+        written = fwrite(padding, 1, (size_t)(table[i].offset - position), file) == table[i].offset - position
+            && fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+        position = table[i].offset + table[i].size;
+    }
+    return fclose(file) == 0 && written;
+}
+
+// Builds every mip level below an 8-bit image by averaging 2x2 blocks, the
+// way glGenerateMipmap does for power-of-two sizes. levels[0] is the image.
+// ----------------------------------------------------------------------------
+inline void buildMipChain(std::vector<std::vector<unsigned char> >& levels, int width, int height, int channels)
+{
+    while (width > 1 || height > 1)
+    {
+        const std::vector<unsigned char>& src = levels.back();
+        int w = width > 1 ? width / 2 : 1;
+        int h = height > 1 ? height / 2 : 1;
+        std::vector<unsigned char> dst((size_t)w * h * channels);
+        for (int y = 0; y < h; ++y)
+        {
+            const unsigned char* row0 = &src[(size_t)(2 * y < height ? 2 * y : height - 1) * width * channels];
+            const unsigned char* row1 = &src[(size_t)(2 * y + 1 < height ? 2 * y + 1 : height - 1) * width * channels];
+            unsigned char* out = &dst[(size_t)y * w * channels];
+            for (int x = 0; x < w; ++x)
+            {
+                int x0 = 2 * x < width ? 2 * x : width - 1;
+                int x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+                for (int c = 0; c < channels; ++c)
+                {
+                    int sum = row0[x0 * channels + c] + row0[x1 * channels + c] + row1[x0 * channels + c] + row1[x1 * channels + c];
+                    out[x * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+        width = w;
+        height = h;
+    }
+}
+#endif
@@ -0,0 +1,578 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <thread_pool.h>
+
+// CPU encoders and decoders for the two block-compressed formats the scene
+// textures can be stored in. Both work on 4x4 pixel blocks:
+//   BC1 (DXT1)       8 bytes per block, two RGB565 endpoints, 4 colors
+//   BC7, mode 6     16 bytes per block, two RGBA 7.7.7.7+1 endpoints, 16 colors
+// Only BC7 mode 6 is produced; it is the single-subset mode that suits
+// photographic textures, and the decoder below reads only that mode.
+enum BlockFormat
+{
+    BLOCK_BC1,
+    BLOCK_BC7
+};
+
+inline size_t blockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+// bytes taken by a width x height image in format
+inline size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+namespace block_compress_detail
+{
+    // BC7 interpolation weights for 4-bit indices, out of 64
+    const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    inline float clamp255(float value)
+    {
+        return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+    }
+
+    // principal axis of the block's colors through their mean, by power iteration
+    inline void principalAxis(const float (*pixels)[4], int channels, float* mean, float* axis)
+    {
+        float covariance[4][4] = {};
+        for (int c = 0; c < channels; ++c)
+        {
+            mean[c] = 0.0f;
+            for (int i = 0; i < 16; ++i)
+                mean[c] += pixels[i][c];
+            mean[c] /= 16.0f;
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = a; b < channels; ++b)
+                    covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+            }
+        }
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < a; ++b)
+                covariance[a][b] = covariance[b][a];
+        }
+
+        for (int c = 0; c < channels; ++c)
+            axis[c] = 1.0f;
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = 0; b < channels; ++b)
+                    next[a] += covariance[a][b] * axis[b];
+                length += next[a] * next[a];
+            }
+            if (length < 1e-12f)
+                break;
+            length = 1.0f / std::sqrt(length);
+            for (int c = 0; c < channels; ++c)
+                axis[c] = next[c] * length;
+        }
+    }
+
+    // endpoints at the extremes of the block's projection on its principal axis
+    inline void fitEndpoints(const float (*pixels)[4], int channels, float* e0, float* e1)
+    {
+        float mean[4], axis[4];
+        principalAxis(pixels, channels, mean, axis);
+        float lo = 0.0f, hi = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channels; ++c)
+                t += (pixels[i][c] - mean[c]) * axis[c];
+            lo = t < lo ? t : lo;
+            hi = t > hi ? t : hi;
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            e0[c] = clamp255(mean[c] + lo * axis[c]);
+            e1[c] = clamp255(mean[c] + hi * axis[c]);
+        }
+    }
+
+    // least-squares endpoints for fixed per-pixel weights of e1 (0..1);
+    // false if the weights do not determine both endpoints
+    inline bool refineEndpoints(const float (*pixels)[4], int channels, const float* weights, float* e0, float* e1)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; ++c)
+            {
+                ax[c] += a * pixels[i][c];
+                bx[c] += b * pixels[i][c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return false;
+        float inverse = 1.0f / determinant;
+        for (int c = 0; c < channels; ++c)
+        {
+            e0[c] = clamp255((bb * ax[c] - ab * bx[c]) * inverse);
+            e1[c] = clamp255((aa * bx[c] - ab * ax[c]) * inverse);
+        }
+        return true;
+    }
+
+    // gathers a 4x4 block as floats, repeating the last row and column past the edges
+    inline void loadBlock(const unsigned char* image, int width, int height, int channels, int bx, int by, float (*pixels)[4])
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+            for (int x = 0; x < 4; ++x)
+            {
+                int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                const unsigned char* p = image + ((size_t)sy * width + sx) * channels;
+                float* out = pixels[y * 4 + x];
+                out[0] = p[0];
+                out[1] = p[1];
+                out[2] = p[2];
+                out[3] = channels == 4 ? p[3] : 255.0f;
+            }
+        }
+    }
+
+    inline uint16_t packRGB565(const float* color)
+    {
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackRGB565(uint16_t packed, int* color)
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // the four colors of a BC1 block in opaque (c0 > c1) mode
+    inline void bc1Palette(uint16_t c0, uint16_t c1, int (*palette)[3])
+    {
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            if (c0 > c1)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+    }
+
+    // picks each pixel's nearest palette color, returns the squared error
+    inline float bc1Indices(const float (*pixels)[4], uint16_t c0, uint16_t c1, uint32_t& indices)
+    {
+        int palette[4][3];
+        bc1Palette(c0, c1, palette);
+        indices = 0;
+        float total = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float best = 1e30f;
+            uint32_t bestIndex = 0;
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                float dr = pixels[i][0] - palette[p][0];
+                float dg = pixels[i][1] - palette[p][1];
+                float db = pixels[i][2] - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if (error < best)
+                {
+                    best = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (2 * i);
+            total += best;
+        }
+        return total;
+    }
+
+    // quantizes an 8-bit endpoint to 7 bits plus the p-bit that fits it best
+    inline void quantizeBC7Endpoint(const float* color, int* quantized, int& pbit)
+    {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; ++p)
+        {
+            int q[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                int v = (int)((color[c] - p) * 0.5f + 0.5f);
+                q[c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+                float d = color[c] - ((q[c] << 1) | p);
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pbit = p;
+                memcpy(quantized, q, sizeof(q));
+            }
+        }
+    }
+
+    // chooses each pixel's index between two 8-bit RGBA endpoints, returns the squared error
+    inline float bc7Indices(const float (*pixels)[4], const int* e0, const int* e1, int* indices)
+    {
+        int palette[16][4];
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+                palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0[c] + BC7_WEIGHTS[i] * e1[c] + 32) >> 6;
+        }
+        float direction[4];
+        float length = 0.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            direction[c] = (float)(e1[c] - e0[c]);
+            length += direction[c] * direction[c];
+        }
+
+        float total = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            // project on the endpoint line, then check the neighbours of the closest weight
+            float t = 0.0f;
+            if (length > 0.0f)
+            {
+                for (int c = 0; c < 4; ++c)
+                    t += (pixels[i][c] - e0[c]) * direction[c];
+                t /= length;
+            }
+            int guess = (int)(t * 15.0f + 0.5f);
+            guess = guess < 0 ? 0 : (guess > 15 ? 15 : guess);
+
+            float best = 1e30f;
+            int bestIndex = guess;
+            for (int candidate = guess - 1; candidate <= guess + 1; ++candidate)
+            {
+                if (candidate < 0 || candidate > 15)
+                    continue;
+                float error = 0.0f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    float d = pixels[i][c] - palette[candidate][c];
+                    error += d * d;
+                }
+                if (error < best)
+                {
+                    best = error;
+                    bestIndex = candidate;
+                }
+            }
+            indices[i] = bestIndex;
+            total += best;
+        }
+        return total;
+    }
+
+    // appends count bits of value to a 128-bit little-endian block
+    inline void writeBits(unsigned char* block, int& position, uint32_t value, int count)
+    {
+        for (int i = 0; i < count; ++i, ++position)
+        {
+            if (value & (1u << i))
+                block[position >> 3] |= (unsigned char)(1u << (position & 7));
+        }
+    }
+
+    inline uint32_t readBits(const unsigned char* block, int& position, int count)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < count; ++i, ++position)
+            value |= (uint32_t)((block[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+}
+
+// Encodes one 4x4 block of floats (RGBA, alpha ignored) as BC1
+// ----------------------------------------------------------------------------
+inline void encodeBC1Block(const float (*pixels)[4], unsigned char* out)
+{
+    using namespace block_compress_detail;
+    float e0[4], e1[4];
+    fitEndpoints(pixels, 3, e0, e1);
+
+    uint16_t bestC0 = 0, bestC1 = 0;
+    uint32_t bestIndices = 0;
+    float bestError = 1e30f;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        uint16_t c0 = packRGB565(e1);
+        uint16_t c1 = packRGB565(e0);
+        // c0 > c1 selects the 4-color mode; equal endpoints only need index 0
+        if (c0 < c1)
+        {
+            uint16_t tmp = c0;
+            c0 = c1;
+            c1 = tmp;
+        }
+        uint32_t indices;
+        float error = bc1Indices(pixels, c0, c1, indices);
+        if (c0 == c1)
+        {
+            indices = 0;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            bestC0 = c0;
+            bestC1 = c1;
+            bestIndices = indices;
+        }
+        if (c0 == c1)
+            break;
+
+        // refit the endpoints to the chosen indices and try again
+        static const float WEIGHT_OF_C1[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        float weights[16];
+        for (int i = 0; i < 16; ++i)
+            weights[i] = WEIGHT_OF_C1[(indices >> (2 * i)) & 3];
+        float r0[4], r1[4];
+        if (!refineEndpoints(pixels, 3, weights, r0, r1))
+            break;
+        // refineEndpoints gives (c0, c1); packing above expects (e1, e0)
+        memcpy(e1, r0, sizeof(r0));
+        memcpy(e0, r1, sizeof(r1));
+    }
+
+    out[0] = (unsigned char)(bestC0 & 0xff);
+    out[1] = (unsigned char)(bestC0 >> 8);
+    out[2] = (unsigned char)(bestC1 & 0xff);
+    out[3] = (unsigned char)(bestC1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(bestIndices >> (8 * i));
+}
+
+// Encodes one 4x4 block of RGBA floats as BC7 mode 6
+// ----------------------------------------------------------------------------
+inline void encodeBC7Block(const float (*pixels)[4], unsigned char* out)
+{
+    using namespace block_compress_detail;
+    float e0[4], e1[4];
+    fitEndpoints(pixels, 4, e0, e1);
+
+    int bestQ0[4] = {}, bestQ1[4] = {}, bestP0 = 0, bestP1 = 0, bestIndices[16] = {};
+    float bestError = 1e30f;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        int q0[4], q1[4], p0, p1;
+        quantizeBC7Endpoint(e0, q0, p0);
+        quantizeBC7Endpoint(e1, q1, p1);
+        int d0[4], d1[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            d0[c] = (q0[c] << 1) | p0;
+            d1[c] = (q1[c] << 1) | p1;
+        }
+        int indices[16];
+        float error = bc7Indices(pixels, d0, d1, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(bestQ0, q0, sizeof(q0));
+            memcpy(bestQ1, q1, sizeof(q1));
+            bestP0 = p0;
+            bestP1 = p1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (error == 0.0f)
+            break;
+
+        float weights[16];
+        for (int i = 0; i < 16; ++i)
+            weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        if (!refineEndpoints(pixels, 4, weights, e0, e1))
+            break;
+    }
+
+    // the anchor (pixel 0) index is stored without its top bit, which must be 0
+    if (bestIndices[0] & 8)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int tmp = bestQ0[c];
+            bestQ0[c] = bestQ1[c];
+            bestQ1[c] = tmp;
+        }
+        int tmp = bestP0;
+        bestP0 = bestP1;
+        bestP1 = tmp;
+        for (int i = 0; i < 16; ++i)
+            bestIndices[i] = 15 - bestIndices[i];
+    }
+
+    memset(out, 0, 16);
+    int position = 0;
+    writeBits(out, position, 1u << 6, 7);       // mode 6
+    for (int c = 0; c < 4; ++c)
+    {
+        writeBits(out, position, bestQ0[c], 7);
+        writeBits(out, position, bestQ1[c], 7);
+    }
+    writeBits(out, position, bestP0, 1);
+    writeBits(out, position, bestP1, 1);
+    writeBits(out, position, bestIndices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        writeBits(out, position, bestIndices[i], 4);
+}
+
+// Decodes one BC1 block into 16 RGB pixels
+// ----------------------------------------------------------------------------
+inline void decodeBC1Block(const unsigned char* block, unsigned char (*pixels)[3])
+{
+    using namespace block_compress_detail;
+    uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+    int palette[4][3];
+    bc1Palette(c0, c1, palette);
+    for (int i = 0; i < 16; ++i)
+    {
+        const int* color = palette[(indices >> (2 * i)) & 3];
+        for (int c = 0; c < 3; ++c)
+            pixels[i][c] = (unsigned char)color[c];
+    }
+}
+
+// Decodes one BC7 mode 6 block into 16 RGB pixels; other modes decode black
+// ----------------------------------------------------------------------------
+inline bool decodeBC7Block(const unsigned char* block, unsigned char (*pixels)[3])
+{
+    using namespace block_compress_detail;
+    int position = 0;
+    if (readBits(block, position, 7) != (1u << 6))
+    {
+        memset(pixels, 0, 16 * 3);
+        return false;
+    }
+    int q[2][4];
+    for (int c = 0; c < 4; ++c)
+    {
+        q[0][c] = (int)readBits(block, position, 7);
+        q[1][c] = (int)readBits(block, position, 7);
+    }
+    int p0 = (int)readBits(block, position, 1);
+    int p1 = (int)readBits(block, position, 1);
+    for (int i = 0; i < 16; ++i)
+    {
+        int index = (int)readBits(block, position, i == 0 ? 3 : 4);
+        int weight = BC7_WEIGHTS[index];
+        for (int c = 0; c < 3; ++c)
+        {
+            int e0 = (q[0][c] << 1) | p0;
+            int e1 = (q[1][c] << 1) | p1;
+            pixels[i][c] = (unsigned char)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+// Compresses an 8-bit RGB or RGBA image, rows of blocks spread over the
+// shared thread pool. out must hold compressedSize() bytes.
+// ----------------------------------------------------------------------------
+inline void compressImage(BlockFormat format, const unsigned char* image, int width, int height, int channels,
+    unsigned char* out)
+{
+    const int blocksWide = (width + 3) / 4;
+    const int blocksHigh = (height + 3) / 4;
+    const size_t bytes = blockBytes(format);
+    sharedThreadPool().parallelFor(blocksHigh, [&](int begin, int end)
+    {
+        float pixels[16][4];
+        for (int by = begin; by < end; ++by)
+        {
+            unsigned char* row = out + (size_t)by * blocksWide * bytes;
+            for (int bx = 0; bx < blocksWide; ++bx)
+            {
+                block_compress_detail::loadBlock(image, width, height, channels, bx, by, pixels);
+                if (format == BLOCK_BC1)
+                    encodeBC1Block(pixels, row + bx * bytes);
+                else
+                    encodeBC7Block(pixels, row + bx * bytes);
+            }
+        }
+    });
+}
+
+// Decompresses a whole image into 8-bit RGB
+// ----------------------------------------------------------------------------
+inline void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* out)
+{
+    const int blocksWide = (width + 3) / 4;
+    const int blocksHigh = (height + 3) / 4;
+    const size_t bytes = blockBytes(format);
+    unsigned char pixels[16][3];
+    for (int by = 0; by < blocksHigh; ++by)
+    {
+        for (int bx = 0; bx < blocksWide; ++bx)
+        {
+            const unsigned char* block = blocks + ((size_t)by * blocksWide + bx) * bytes;
+            if (format == BLOCK_BC1)
+                decodeBC1Block(block, pixels);
+            else
+                decodeBC7Block(block, pixels);
+            for (int y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+                    memcpy(out + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 3, pixels[y * 4 + x], 3);
+            }
+        }
+    }
+}
+
+// Peak signal-to-noise ratio in dB between the RGB channels of two images
+// ----------------------------------------------------------------------------
+inline double psnrRGB(const unsigned char* a, int aChannels, const unsigned char* b, int bChannels, int width, int height)
+{
+    double squared = 0.0;
+    const size_t count = (size_t)width * height;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            double d = (double)a[i * aChannels + c] - b[i * bChannels + c];
+            squared += d * d;
+        }
+    }
+    double mse = squared / (count * 3.0);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+#endif
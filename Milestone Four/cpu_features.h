@@ -0,0 +1,57 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime detection of the x86 SIMD extensions used by the hot loops, so one
+// binary can carry AVX2 paths and still run on CPUs without AVX2.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Functions using AVX2 intrinsics are marked with this; GCC and Clang only
+// accept the intrinsics in functions compiled for the target, MSVC always does
+#if defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_TARGET_AVX2
+#endif
+
+struct CpuFeatures
+{
+    bool sse2 = false;
+    bool avx2 = false;
+};
+
+inline CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+#if defined(CPU_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+    // AVX2 also needs the OS to save the YMM registers (OSXSAVE + XCR0)
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7 && osSavesYmm)
+    {
+        __cpuidex(info, 7, 0);
+        features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#elif defined(CPU_X86)
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2") != 0;
+    features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    return features;
+}
+
+inline const CpuFeatures& cpuFeatures()
+{
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+#endif
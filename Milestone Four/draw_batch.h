@@ -0,0 +1,216 @@
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <mesh_arena.h>
+#include <render_stats.h>
+
+// Layout of one glMultiDrawElementsIndirect command, fixed by the GL spec
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// One placement of a mesh: its transform, applied before the scene's model
+// matrix, and the material it is drawn with
+struct DrawInstance
+{
+    glm::mat4 transform;
+    GLuint material;
+};
+
+// Submits any number of mesh arena ranges, each drawn any number of times,
+// with a single glMultiDrawElementsIndirect. Every instance gets a record
+// (its transform and material index) in an instance buffer, fed to the
+// vertex shader as instanced attributes; each command's baseInstance points
+// at the first record of its mesh, so the shader knows which instance it
+// draws without any state change in between. Instances that move later get
+// their records rewritten with setTransform() and updateInstances().
+// Requires GL 4.3 (or ARB_multi_draw_indirect); drawInstanced() issues the
+// same commands one glDrawElementsInstanced at a time and only needs GL 4.2.
+class DrawBatch
+{
+public:
+    DrawBatch() : mCommandBuffer(0), mInstanceBuffer(0), mDrawCount(0), mInstanceCount(0), mTriangleCount(0),
+        mDirtyFirst(0), mDirtyEnd(0)
+    {
+    }
+
+    // queues a mesh to be drawn once, untransformed, with the given material;
+    // returns the index of its instance record
+    // ------------------------------------------------------------------------
+    GLuint add(const GLMesh& mesh, GLuint material)
+    {
+        DrawInstance instance;
+        instance.transform = glm::mat4(1.0f);
+        instance.material = material;
+        return add(mesh, &instance, 1);
+    }
+
+    // queues a mesh to be drawn once per instance; returns the index of the
+    // first instance's record, the others follow it
+    // ------------------------------------------------------------------------
+    GLuint add(const GLMesh& mesh, const DrawInstance* instances, GLuint count)
+    {
+        const GLuint first = (GLuint)mInstances.size();
+        if (count == 0)
+            return first;
+        DrawElementsIndirectCommand command;
+        command.count = mesh.nIndices;
+        command.instanceCount = count;
+        command.firstIndex = mesh.firstIndex;
+        command.baseVertex = mesh.baseVertex;
+        command.baseInstance = first;
+        mCommands.push_back(command);
+        mInstances.insert(mInstances.end(), instances, instances + count);
+        return first;
+    }
+
+    // uploads the queued draws and attaches the instance records to the
+    // currently bound VAO: the material index to materialLocation, the
+    // transform's columns to transformLocation and the three after it
+    // ------------------------------------------------------------------------
+    void upload(GLuint materialLocation, GLuint transformLocation)
+    {
+        if (mCommandBuffer == 0)
+        {
+            glGenBuffers(1, &mCommandBuffer);
+            glGenBuffers(1, &mInstanceBuffer);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, mCommands.size() * sizeof(DrawElementsIndirectCommand), mCommands.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        const GLsizei stride = sizeof(DrawInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, mInstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, mInstances.size() * sizeof(DrawInstance), mInstances.data(), GL_DYNAMIC_DRAW);
+        glVertexAttribIPointer(materialLocation, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(DrawInstance, material));
+        glVertexAttribDivisor(materialLocation, 1);
+        glEnableVertexAttribArray(materialLocation);
+        for (GLuint column = 0; column < 4; ++column)
+        {
+            const size_t offset = offsetof(DrawInstance, transform) + column * sizeof(glm::vec4);
+            glVertexAttribPointer(transformLocation + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+            glVertexAttribDivisor(transformLocation + column, 1);
+            glEnableVertexAttribArray(transformLocation + column);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        mDrawCount = (GLsizei)mCommands.size();
+        mInstanceCount = mInstances.size();
+        mTriangleCount = 0;
+        for (const DrawElementsIndirectCommand& command : mCommands)
+            mTriangleCount += (size_t)command.count / 3 * command.instanceCount;
+        // drawInstanced() reads the commands back from here, setTransform()
+        // edits the records
+        mUploaded.swap(mCommands);
+        mUploadedInstances.swap(mInstances);
+        mCommands.clear();
+        mInstances.clear();
+        mDirtyFirst = mDirtyEnd = 0;
+    }
+
+    // replaces the transform of an uploaded instance; the instance buffer
+    // keeps the old one until updateInstances()
+    // ------------------------------------------------------------------------
+    void setTransform(GLuint instance, const glm::mat4& transform)
+    {
+        mUploadedInstances[instance].transform = transform;
+        if (mDirtyFirst == mDirtyEnd)
+        {
+            mDirtyFirst = instance;
+            mDirtyEnd = instance + 1;
+        }
+        else
+        {
+            mDirtyFirst = std::min(mDirtyFirst, instance);
+            mDirtyEnd = std::max(mDirtyEnd, instance + 1);
+        }
+    }
+
+    // rewrites the range of instance records setTransform() changed since the
+    // last call, with one glBufferSubData
+    // ------------------------------------------------------------------------
+    void updateInstances()
+    {
+        if (mDirtyFirst == mDirtyEnd)
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, mInstanceBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, mDirtyFirst * sizeof(DrawInstance),
+            (mDirtyEnd - mDirtyFirst) * sizeof(DrawInstance), &mUploadedInstances[mDirtyFirst]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        ++renderStats().bufferBinds;
+        mDirtyFirst = mDirtyEnd = 0;
+    }
+
+    // issues every uploaded draw, the mesh arena must be bound
+    // ------------------------------------------------------------------------
+    void draw() const
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, mDrawCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        ++renderStats().bufferBinds;
+        ++renderStats().drawCalls;
+    }
+
+    // issues every uploaded draw as a glDrawElementsInstanced of its own, one
+    // draw call per mesh however many instances it has
+    // ------------------------------------------------------------------------
+    void drawInstanced() const
+    {
+        for (const DrawElementsIndirectCommand& command : mUploaded)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, GL_UNSIGNED_SHORT,
+                (void*)(command.firstIndex * sizeof(GLushort)), command.instanceCount, command.baseVertex,
+                command.baseInstance);
+            ++renderStats().drawCalls;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        glDeleteBuffers(1, &mCommandBuffer);
+        glDeleteBuffers(1, &mInstanceBuffer);
+        mCommandBuffer = 0;
+        mInstanceBuffer = 0;
+        mDrawCount = 0;
+        mInstanceCount = 0;
+        mTriangleCount = 0;
+        mUploaded.clear();
+        mUploadedInstances.clear();
+        mDirtyFirst = mDirtyEnd = 0;
+    }
+
+    GLsizei drawCount() const
+    {
+        return mDrawCount;
+    }
+
+    // instances and triangles every draw() renders
+    size_t instanceCount() const { return mInstanceCount; }
+    size_t triangleCount() const { return mTriangleCount; }
+
+private:
+    GLuint mCommandBuffer;
+    GLuint mInstanceBuffer;
+    GLsizei mDrawCount;
+    size_t mInstanceCount;
+    size_t mTriangleCount;
+    std::vector<DrawElementsIndirectCommand> mCommands;   // staged until upload()
+    std::vector<DrawInstance> mInstances;                 // staged until upload()
+    std::vector<DrawElementsIndirectCommand> mUploaded;   // the commands in the command buffer
+    std::vector<DrawInstance> mUploadedInstances;         // the records in the instance buffer
+    GLuint mDirtyFirst, mDirtyEnd;                        // records changed since updateInstances()
+};
+#endif
@@ -0,0 +1,258 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <vector>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+
+#include <render_stats.h>
+
+// Records the CPU time, GPU time and draw/state-change counts of every frame
+// of a benchmark run and reports their percentiles as JSON.
+// GPU time comes from GL_TIME_ELAPSED queries kept in a small ring: a query
+// is only read back QUERY_LATENCY frames after it was issued, by which point
+// the GPU has finished it and the read does not stall the pipeline.
+class FrameProfiler
+{
+public:
+    static const unsigned int QUERY_LATENCY = 4;
+
+    FrameProfiler() : mWarmup(0), mFrame(0), mInFrame(false), mStartupMs(-1.0), mTexturesMs(-1.0),
+        mTexturesColdMs(-1.0), mTexturesWarmMs(-1.0), mInstances(0), mTriangles(0)
+    {
+        for (unsigned int i = 0; i < QUERY_LATENCY; ++i)
+        {
+            mQueries[i] = 0;
+            mPending[i] = -1;
+        }
+    }
+
+    // prepares for frames recorded frames after warmup unrecorded ones
+    // ------------------------------------------------------------------------
+    void create(unsigned int frames, unsigned int warmup)
+    {
+        glGenQueries(QUERY_LATENCY, mQueries);
+        mWarmup = warmup;
+        mFrame = 0;
+        mSamples.clear();
+        mSamples.reserve(frames);
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        glDeleteQueries(QUERY_LATENCY, mQueries);
+        for (unsigned int i = 0; i < QUERY_LATENCY; ++i)
+        {
+            mQueries[i] = 0;
+            mPending[i] = -1;
+        }
+    }
+
+    // starts timing a frame on the CPU and the GPU
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        unsigned int slot = mFrame % QUERY_LATENCY;
+        // the query issued QUERY_LATENCY frames ago is done by now
+        collect(slot);
+
+        mRenderBefore = renderStats();
+        mCpuStart = std::chrono::steady_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[slot]);
+        mInFrame = true;
+    }
+
+    // stops the GPU timer, call once every command of the frame is issued
+    // ------------------------------------------------------------------------
+    void endGpuWork()
+    {
+        if (!mInFrame)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        mInFrame = false;
+    }
+
+    // stops the CPU timer and stores the frame's counters
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        endGpuWork();
+        std::chrono::duration<double, std::milli> cpu = std::chrono::steady_clock::now() - mCpuStart;
+
+        unsigned int slot = mFrame % QUERY_LATENCY;
+        if (mFrame++ < mWarmup)
+            return;
+
+        const RenderStats& after = renderStats();
+        Sample sample;
+        sample.cpuMs = cpu.count();
+        sample.gpuMs = 0.0;
+        sample.render.drawCalls = after.drawCalls - mRenderBefore.drawCalls;
+        sample.render.programBinds = after.programBinds - mRenderBefore.programBinds;
+        sample.render.textureBinds = after.textureBinds - mRenderBefore.textureBinds;
+        sample.render.vertexArrayBinds = after.vertexArrayBinds - mRenderBefore.vertexArrayBinds;
+        sample.render.bufferBinds = after.bufferBinds - mRenderBefore.bufferBinds;
+        mPending[slot] = (int)mSamples.size();
+        mSamples.push_back(sample);
+    }
+
+    // waits for the queries still in flight, call before reporting
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        endGpuWork();
+        for (unsigned int i = 0; i < QUERY_LATENCY; ++i)
+            collect(i);
+    }
+
+    // time from launch to the first frame, of which texturesMs went to the
+    // material textures; textureCache says how the cache served them
+    // ------------------------------------------------------------------------
+    void setStartup(double startupMs, double texturesMs, const char* textureCache)
+    {
+        mStartupMs = startupMs;
+        mTexturesMs = texturesMs;
+        mTextureCache = textureCache;
+    }
+
+    // how long the textures took to load again without the texture cache
+    // and from it, reported with the startup
+    // ------------------------------------------------------------------------
+    void setTextureLoads(double coldMs, double warmMs)
+    {
+        mTexturesColdMs = coldMs;
+        mTexturesWarmMs = warmMs;
+    }
+
+    // instances and triangles every recorded frame draws
+    // ------------------------------------------------------------------------
+    void setScene(size_t instances, size_t triangles)
+    {
+        mInstances = instances;
+        mTriangles = triangles;
+    }
+
+    // writes the percentiles of every recorded frame as one JSON object
+    // ------------------------------------------------------------------------
+    void writeJSON(std::ostream& out, const char* renderer) const
+    {
+        std::vector<double> cpu, gpu;
+        RenderStats totals;
+        for (const Sample& sample : mSamples)
+        {
+            cpu.push_back(sample.cpuMs);
+            gpu.push_back(sample.gpuMs);
+            totals.drawCalls += sample.render.drawCalls;
+            totals.programBinds += sample.render.programBinds;
+            totals.textureBinds += sample.render.textureBinds;
+            totals.vertexArrayBinds += sample.render.vertexArrayBinds;
+            totals.bufferBinds += sample.render.bufferBinds;
+        }
+        const double frames = mSamples.empty() ? 1.0 : (double)mSamples.size();
+
+        out << "{\n";
+        out << "  \"renderer\": \"" << escape(renderer) << "\",\n";
+        out << "  \"frames\": " << mSamples.size() << ",\n";
+        out << "  \"warmup_frames\": " << mWarmup << ",\n";
+        if (mStartupMs >= 0.0)
+        {
+            out << "  \"startup\": {\"ms\": " << mStartupMs << ", \"textures_ms\": " << mTexturesMs
+                << ", \"texture_cache\": \"" << escape(mTextureCache.c_str()) << "\"";
+            if (mTexturesColdMs >= 0.0)
+                out << ", \"textures_cold_ms\": " << mTexturesColdMs << ", \"textures_warm_ms\": " << mTexturesWarmMs;
+            out << "},\n";
+        }
+        if (mInstances != 0)
+            out << "  \"scene\": {\"instances\": " << mInstances << ", \"triangles\": " << mTriangles << "},\n";
+        out << "  \"cpu_ms\": ";
+        writePercentiles(out, cpu);
+        out << ",\n  \"gpu_ms\": ";
+        writePercentiles(out, gpu);
+        out << ",\n  \"per_frame\": {"
+            << "\"draw_calls\": " << totals.drawCalls / frames
+            << ", \"program_binds\": " << totals.programBinds / frames
+            << ", \"texture_binds\": " << totals.textureBinds / frames
+            << ", \"vertex_array_binds\": " << totals.vertexArrayBinds / frames
+            << ", \"buffer_binds\": " << totals.bufferBinds / frames << "}\n";
+        out << "}" << std::endl;
+    }
+
+private:
+    struct Sample
+    {
+        double cpuMs;
+        double gpuMs;
+        RenderStats render;
+    };
+
+    // reads back the query in slot if it belongs to a recorded frame
+    // ------------------------------------------------------------------------
+    void collect(unsigned int slot)
+    {
+        if (mPending[slot] < 0)
+            return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(mQueries[slot], GL_QUERY_RESULT, &elapsed);
+        mSamples[mPending[slot]].gpuMs = elapsed / 1000000.0;
+        mPending[slot] = -1;
+    }
+
+    // nearest-rank percentiles over a sorted copy
+    // ------------------------------------------------------------------------
+    static void writePercentiles(std::ostream& out, std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            out << "null";
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        out << "{\"mean\": " << sum / values.size()
+            << ", \"p50\": " << percentile(values, 50.0)
+            << ", \"p95\": " << percentile(values, 95.0)
+            << ", \"p99\": " << percentile(values, 99.0)
+            << ", \"max\": " << values.back() << "}";
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    static std::string escape(const char* text)
+    {
+        std::string escaped;
+        for (; text != nullptr && *text != '\0'; ++text)
+        {
+            if (*text == '"' || *text == '\\')
+                escaped += '\\';
+            escaped += *text;
+        }
+        return escaped;
+    }
+
+    GLuint mQueries[QUERY_LATENCY];
+    int mPending[QUERY_LATENCY];        // sample waiting for each query, -1 if none
+    unsigned int mWarmup;
+    unsigned int mFrame;
+    bool mInFrame;
+    RenderStats mRenderBefore;
+    std::chrono::steady_clock::time_point mCpuStart;
+    std::vector<Sample> mSamples;
+    double mStartupMs;                  // -1 until setStartup()
+    double mTexturesMs;
+    std::string mTextureCache;
+    double mTexturesColdMs;             // -1 until setTextureLoads()
+    double mTexturesWarmMs;
+    size_t mInstances;                  // 0 until setScene()
+    size_t mTriangles;
+};
+#endif
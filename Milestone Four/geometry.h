@@ -0,0 +1,267 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include <vertex_format.h>
+
+// Storage the primitive generators append to. The caller owns both arrays
+// and sizes them with the *Counts() functions; generators never allocate,
+// and a primitive that does not fit is not written at all. Indices are
+// relative to the start of the buffer, so it holds at most 65536 vertices.
+struct GeometryBuffer
+{
+    SourceVertex* vertices;
+    size_t vertexCapacity;
+    size_t vertexCount;
+    GLushort* indices;
+    size_t indexCapacity;
+    size_t indexCount;
+
+    GeometryBuffer(SourceVertex* vertexStorage, size_t vertexSlots, GLushort* indexStorage, size_t indexSlots)
+        : vertices(vertexStorage), vertexCapacity(vertexSlots), vertexCount(0),
+        indices(indexStorage), indexCapacity(indexSlots), indexCount(0)
+    {
+    }
+
+    // forgets the primitives, keeping the storage
+    void clear()
+    {
+        vertexCount = 0;
+        indexCount = 0;
+    }
+};
+
+// Vertices and indices a primitive takes
+struct GeometryCounts
+{
+    size_t vertices;
+    size_t indices;
+
+    GeometryCounts& operator+=(const GeometryCounts& other)
+    {
+        vertices += other.vertices;
+        indices += other.indices;
+        return *this;
+    }
+};
+
+// Faces addBox() generates, combined with |
+enum BoxFace
+{
+    BOX_LEFT = 1,       // -x
+    BOX_RIGHT = 2,      // +x
+    BOX_BOTTOM = 4,     // -y
+    BOX_TOP = 8,        // +y
+    BOX_BACK = 16,      // -z
+    BOX_FRONT = 32,     // +z
+    BOX_WALLS = BOX_LEFT | BOX_RIGHT | BOX_BACK | BOX_FRONT,
+    BOX_ALL_FACES = 63
+};
+
+namespace geometry_detail
+{
+    inline bool fits(const GeometryBuffer& buffer, const GeometryCounts& counts)
+    {
+        return buffer.vertexCount + counts.vertices <= buffer.vertexCapacity
+            && buffer.indexCount + counts.indices <= buffer.indexCapacity
+            && buffer.vertexCount + counts.vertices <= 65536;
+    }
+
+    inline void vertex(GeometryBuffer& buffer, const glm::vec3& position, const glm::vec3& normal, float u, float v)
+    {
+        SourceVertex& out = buffer.vertices[buffer.vertexCount++];
+        out.position[0] = position.x;
+        out.position[1] = position.y;
+        out.position[2] = position.z;
+        out.normal[0] = normal.x;
+        out.normal[1] = normal.y;
+        out.normal[2] = normal.z;
+        out.color[0] = out.color[1] = out.color[2] = out.color[3] = 1.0f;
+        out.uv[0] = u;
+        out.uv[1] = v;
+        out.tangent[0] = out.tangent[1] = out.tangent[2] = out.tangent[3] = 0.0f;
+    }
+
+    inline void triangle(GeometryBuffer& buffer, size_t a, size_t b, size_t c)
+    {
+        buffer.indices[buffer.indexCount++] = (GLushort)a;
+        buffer.indices[buffer.indexCount++] = (GLushort)b;
+        buffer.indices[buffer.indexCount++] = (GLushort)c;
+    }
+
+    // the parallelogram origin, +edgeU, +edgeU+edgeV, +edgeV, facing cross(edgeU, edgeV)
+    inline void quad(GeometryBuffer& buffer, const glm::vec3& origin, const glm::vec3& edgeU, const glm::vec3& edgeV,
+        float repeatU, float repeatV)
+    {
+        const glm::vec3 normal = glm::normalize(glm::cross(edgeU, edgeV));
+        const size_t first = buffer.vertexCount;
+        vertex(buffer, origin, normal, 0.0f, 0.0f);
+        vertex(buffer, origin + edgeU, normal, repeatU, 0.0f);
+        vertex(buffer, origin + edgeU + edgeV, normal, repeatU, repeatV);
+        vertex(buffer, origin + edgeV, normal, 0.0f, repeatV);
+        triangle(buffer, first, first + 1, first + 2);
+        triangle(buffer, first, first + 2, first + 3);
+    }
+
+    // a fan from center over points, facing normal; points[i] are at
+    // center + radius * (cos a * axisU + sin a * axisV) for angles a from
+    // start to end, and the fan winds counter-clockwise around normal
+    inline void fan(GeometryBuffer& buffer, const glm::vec3& center, const glm::vec3& axisU, const glm::vec3& axisV,
+        float radius, float start, float end, int segments, const glm::vec3& normal, float uvScale, bool reverse)
+    {
+        const size_t first = buffer.vertexCount;
+        vertex(buffer, center, normal, 0.0f, 0.0f);
+        for (int i = 0; i <= segments; ++i)
+        {
+            const float angle = start + (end - start) * i / segments;
+            const float c = std::cos(angle) * radius, s = std::sin(angle) * radius;
+            vertex(buffer, center + axisU * c + axisV * s, normal, c * uvScale, s * uvScale);
+        }
+        for (int i = 0; i < segments; ++i)
+        {
+            if (reverse)
+                triangle(buffer, first, first + 2 + i, first + 1 + i);
+            else
+                triangle(buffer, first, first + 1 + i, first + 2 + i);
+        }
+    }
+
+    // the curved side swept by points like fan()'s along length * axis,
+    // facing outward; u runs along the curve, v along the axis
+    inline void sweep(GeometryBuffer& buffer, const glm::vec3& center, const glm::vec3& axisU, const glm::vec3& axisV,
+        const glm::vec3& axis, float length, float radius, float start, float end, int segments, float uvScale)
+    {
+        const size_t first = buffer.vertexCount;
+        for (int i = 0; i <= segments; ++i)
+        {
+            const float angle = start + (end - start) * i / segments;
+            const glm::vec3 normal = axisU * std::cos(angle) + axisV * std::sin(angle);
+            const glm::vec3 point = center + normal * radius;
+            const float u = radius * (angle - start) * uvScale;
+            vertex(buffer, point, normal, u, 0.0f);
+            vertex(buffer, point + axis * length, normal, u, length * uvScale);
+        }
+        // near edge at even vertices, far edge at odd ones; the angle grows
+        // counter-clockwise around axis, so this order faces outward
+        for (int i = 0; i < segments; ++i)
+        {
+            const size_t near0 = first + 2 * i, far0 = near0 + 1, near1 = near0 + 2, far1 = near0 + 3;
+            triangle(buffer, near0, near1, far1);
+            triangle(buffer, near0, far1, far0);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+inline GeometryCounts quadCounts()
+{
+    GeometryCounts counts = { 4, 6 };
+    return counts;
+}
+
+inline GeometryCounts boxCounts(unsigned int faces = BOX_ALL_FACES)
+{
+    size_t count = 0;
+    for (unsigned int face = faces & BOX_ALL_FACES; face != 0; face &= face - 1)
+        ++count;
+    GeometryCounts counts = { 4 * count, 6 * count };
+    return counts;
+}
+
+inline GeometryCounts arcCounts(int segments, bool caps = true)
+{
+    GeometryCounts counts = { 2 * (size_t)(segments + 1), 6 * (size_t)segments };
+    if (caps)
+    {
+        counts.vertices += 2 * (size_t)(segments + 2);
+        counts.indices += 6 * (size_t)segments;
+    }
+    return counts;
+}
+
+inline GeometryCounts cylinderCounts(int segments, bool caps = true)
+{
+    return arcCounts(segments, caps);
+}
+
+// A parallelogram from origin along edgeU and edgeV, facing
+// cross(edgeU, edgeV), with the texture repeated repeatU by repeatV times
+// ----------------------------------------------------------------------------
+inline bool addQuad(GeometryBuffer& buffer, const glm::vec3& origin, const glm::vec3& edgeU, const glm::vec3& edgeV,
+    float repeatU = 1.0f, float repeatV = 1.0f)
+{
+    if (!geometry_detail::fits(buffer, quadCounts()))
+        return false;
+    geometry_detail::quad(buffer, origin, edgeU, edgeV, repeatU, repeatV);
+    return true;
+}
+
+// An axis aligned box between min and max, its faces outward and textured
+// uvScale times per unit of length, so boxes of any size match in scale
+// ----------------------------------------------------------------------------
+inline bool addBox(GeometryBuffer& buffer, const glm::vec3& min, const glm::vec3& max, float uvScale,
+    unsigned int faces = BOX_ALL_FACES)
+{
+    if (!geometry_detail::fits(buffer, boxCounts(faces)))
+        return false;
+    const glm::vec3 size = max - min;
+    const glm::vec3 x(size.x, 0.0f, 0.0f), y(0.0f, size.y, 0.0f), z(0.0f, 0.0f, size.z);
+    const float u = size.x * uvScale, v = size.y * uvScale, w = size.z * uvScale;
+    if (faces & BOX_LEFT)
+        geometry_detail::quad(buffer, min, z, y, w, v);
+    if (faces & BOX_RIGHT)
+        geometry_detail::quad(buffer, glm::vec3(max.x, min.y, max.z), -z, y, w, v);
+    if (faces & BOX_BOTTOM)
+        geometry_detail::quad(buffer, min, x, z, u, w);
+    if (faces & BOX_TOP)
+        geometry_detail::quad(buffer, glm::vec3(min.x, max.y, max.z), x, -z, u, w);
+    if (faces & BOX_BACK)
+        geometry_detail::quad(buffer, glm::vec3(max.x, min.y, min.z), -x, y, u, v);
+    if (faces & BOX_FRONT)
+        geometry_detail::quad(buffer, glm::vec3(min.x, min.y, max.z), x, y, u, v);
+    return true;
+}
+
+// An arc of a circle in the xy plane around center, from startAngle to
+// endAngle (radians from +x towards +y) in segments steps, extruded by
+// depth along +z: a vault or rounded roof. caps closes both ends with a
+// fan from center, so a half circle gets flat gables.
+// ----------------------------------------------------------------------------
+inline bool addArc(GeometryBuffer& buffer, const glm::vec3& center, float radius, float startAngle, float endAngle,
+    float depth, int segments, float uvScale, bool caps = true)
+{
+    if (segments < 1 || !geometry_detail::fits(buffer, arcCounts(segments, caps)))
+        return false;
+    const glm::vec3 x(1.0f, 0.0f, 0.0f), y(0.0f, 1.0f, 0.0f), z(0.0f, 0.0f, 1.0f);
+    geometry_detail::sweep(buffer, center, x, y, z, depth, radius, startAngle, endAngle, segments, uvScale);
+    if (caps)
+    {
+        geometry_detail::fan(buffer, center, x, y, radius, startAngle, endAngle, segments, -z, uvScale, true);
+        geometry_detail::fan(buffer, center + z * depth, x, y, radius, startAngle, endAngle, segments, z, uvScale, false);
+    }
+    return true;
+}
+
+// An upright cylinder standing on baseCenter, its side in segments steps
+// ----------------------------------------------------------------------------
+inline bool addCylinder(GeometryBuffer& buffer, const glm::vec3& baseCenter, float radius, float height,
+    int segments, float uvScale, bool caps = true)
+{
+    if (segments < 3 || !geometry_detail::fits(buffer, cylinderCounts(segments, caps)))
+        return false;
+    // angles grow counter-clockwise seen from above: from +x towards -z
+    const glm::vec3 x(1.0f, 0.0f, 0.0f), y(0.0f, 1.0f, 0.0f), minusZ(0.0f, 0.0f, -1.0f);
+    const float fullTurn = 6.28318530718f;
+    geometry_detail::sweep(buffer, baseCenter, x, minusZ, y, height, radius, 0.0f, fullTurn, segments, uvScale);
+    if (caps)
+    {
+        geometry_detail::fan(buffer, baseCenter, x, minusZ, radius, 0.0f, fullTurn, segments, -y, uvScale, true);
+        geometry_detail::fan(buffer, baseCenter + y * height, x, minusZ, radius, 0.0f, fullTurn, segments, y, uvScale, false);
+    }
+    return true;
+}
+#endif
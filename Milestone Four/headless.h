@@ -0,0 +1,181 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+// EGL surfaceless contexts come from Mesa (llvmpipe when there is no GPU) and
+// are only wired up on Linux
+#if defined(__linux__)
+#define HEADLESS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// A desktop GL core context with no window and no display server, created
+// through EGL_MESA_platform_surfaceless. Everything must be rendered into an
+// OffscreenTarget because there is no default framebuffer.
+class HeadlessContext
+{
+public:
+    HeadlessContext()
+#ifdef HEADLESS_EGL
+        : mDisplay(EGL_NO_DISPLAY), mContext(EGL_NO_CONTEXT)
+#endif
+    {
+    }
+
+    // creates the context and makes it current
+    // ------------------------------------------------------------------------
+    bool create(int major, int minor)
+    {
+#ifdef HEADLESS_EGL
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay == nullptr)
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_PLATFORM_DISPLAY" << std::endl;
+            return false;
+        }
+        mDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        EGLint eglMajor, eglMinor;
+        if (mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, &eglMajor, &eglMinor))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+            return false;
+        }
+
+        const EGLint attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        // surfaceless contexts need no config (EGL_KHR_no_config_context)
+        mContext = eglCreateContext(mDisplay, (EGLConfig)0, EGL_NO_CONTEXT, attributes);
+        if (mContext == EGL_NO_CONTEXT || !eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, mContext))
+        {
+            std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        return true;
+#else
+        (void)major;
+        (void)minor;
+        std::cout << "ERROR::HEADLESS::NOT_SUPPORTED_ON_THIS_PLATFORM" << std::endl;
+        return false;
+#endif
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+#ifdef HEADLESS_EGL
+        if (mDisplay != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (mContext != EGL_NO_CONTEXT)
+                eglDestroyContext(mDisplay, mContext);
+            eglTerminate(mDisplay);
+        }
+        mDisplay = EGL_NO_DISPLAY;
+        mContext = EGL_NO_CONTEXT;
+#endif
+    }
+
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay mDisplay;
+    EGLContext mContext;
+#endif
+};
+
+// A framebuffer object with an RGBA8 color and a 24-bit depth renderbuffer,
+// used as the render target when there is no window
+class OffscreenTarget
+{
+public:
+    OffscreenTarget() : mFramebuffer(0), mWidth(0), mHeight(0)
+    {
+        mRenderbuffers[0] = mRenderbuffers[1] = 0;
+    }
+
+    // ------------------------------------------------------------------------
+    bool create(GLsizei width, GLsizei height)
+    {
+        mWidth = width;
+        mHeight = height;
+
+        glGenRenderbuffers(2, mRenderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &mFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mRenderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mRenderbuffers[1]);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::OFFSCREEN::FRAMEBUFFER_INCOMPLETE: 0x" << std::hex << status << std::dec << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    }
+
+    // reads back the color buffer and writes it as a binary PPM (P6), top row first
+    // ------------------------------------------------------------------------
+    bool writePPM(const char* path) const
+    {
+        std::vector<unsigned char> pixels((size_t)mWidth * mHeight * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr)
+        {
+            std::cout << "ERROR::OFFSCREEN::CANNOT_WRITE: " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", mWidth, mHeight);
+        // GL rows start at the bottom, PPM rows at the top
+        for (GLsizei y = mHeight - 1; y >= 0; --y)
+            fwrite(&pixels[(size_t)y * mWidth * 3], 1, (size_t)mWidth * 3, file);
+        fclose(file);
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteRenderbuffers(2, mRenderbuffers);
+        mFramebuffer = 0;
+        mRenderbuffers[0] = mRenderbuffers[1] = 0;
+    }
+
+private:
+    GLuint mFramebuffer;
+    GLuint mRenderbuffers[2];   // color, depth
+    GLsizei mWidth;
+    GLsizei mHeight;
+};
+#endif
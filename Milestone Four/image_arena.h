@@ -0,0 +1,375 @@
+#ifndef IMAGE_ARENA_H
+#define IMAGE_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <image_io.h>
+
+// Bump allocation chunk; requests over half of it get a block of their own
+const size_t IMAGE_ARENA_CHUNK_SIZE = 1 << 20;
+// threads without an arena keep their last freed block up to this size
+const size_t IMAGE_ARENA_SPARE_SIZE = 256 << 10;
+// own blocks are rounded up to this, so close sizes can reuse each other
+const size_t IMAGE_ARENA_LARGE_GRANULE = 64 << 10;
+
+// Scratch memory for decoding one image at a time: small requests are bumped
+// out of chunks, large ones (coefficient and component planes, the output)
+// get blocks that are kept for the next image once freed. reset() forgets
+// every allocation at once but keeps the memory, so after the first few
+// images decoding reaches the heap only for the output pixels, which leave
+// the arena with the caller.
+//
+// allocator() installs one arena per decoding thread with setImageAllocator.
+// Allocations made outside decodeImage(), or by the thread pool's workers
+// helping a decode, go to the heap, except that each such thread keeps one
+// small freed block for its next request: the workers' line buffers are
+// allocated and freed once per band of rows, always at the same size.
+class ImageArena
+{
+public:
+    ImageArena() : mChunk(0), mOffset(0), mLast(nullptr), mReserved(0)
+    {
+    }
+
+    ~ImageArena()
+    {
+        for (Chunk& chunk : mChunks)
+            free(chunk.base);
+        for (Large& large : mLarge)
+            free(large.base);
+    }
+
+    ImageArena(const ImageArena&) = delete;
+    ImageArena& operator=(const ImageArena&) = delete;
+
+    // ------------------------------------------------------------------------
+    void* allocate(size_t size)
+    {
+        const size_t total = sizeof(Header) + roundUp(size, sizeof(Header));
+        if (total > IMAGE_ARENA_CHUNK_SIZE / 2)
+            return allocateLarge(size, total);
+
+        // move on to the next chunk, or add one, until the request fits
+        while (mChunk < mChunks.size() && mOffset + total > mChunks[mChunk].size)
+        {
+            ++mChunk;
+            mOffset = 0;
+        }
+        if (mChunk == mChunks.size())
+        {
+            Chunk chunk;
+            chunk.base = (unsigned char*)malloc(IMAGE_ARENA_CHUNK_SIZE);
+            if (chunk.base == nullptr)
+                return nullptr;
+            chunk.size = IMAGE_ARENA_CHUNK_SIZE;
+            mChunks.push_back(chunk);
+            mOffset = 0;
+            reserve(chunk.size);
+        }
+        Header* header = (Header*)(mChunks[mChunk].base + mOffset);
+        header->size = size;
+        header->capacity = total;
+        header->kind = BLOCK_BUMP;
+        mOffset += total;
+        mLast = header;
+        return header + 1;
+    }
+
+    // ------------------------------------------------------------------------
+    void* reallocate(void* block, size_t size)
+    {
+        if (block == nullptr)
+            return allocate(size);
+        Header* header = (Header*)block - 1;
+        if (header->kind == BLOCK_HEAP)
+            return reallocateHeap(block, size);
+
+        const size_t total = sizeof(Header) + roundUp(size, sizeof(Header));
+        // grows in place if it still fits its block, or is the newest bump
+        // allocation and the chunk has room
+        if (total <= header->capacity)
+        {
+            header->size = size;
+            return block;
+        }
+        if (header == mLast && total <= IMAGE_ARENA_CHUNK_SIZE / 2
+            && mOffset - header->capacity + total <= mChunks[mChunk].size)
+        {
+            mOffset += total - header->capacity;
+            header->size = size;
+            header->capacity = total;
+            return block;
+        }
+        void* moved = allocate(size);
+        if (moved == nullptr)
+            return nullptr;
+        memcpy(moved, block, header->size);
+        release(block);
+        return moved;
+    }
+
+    // bump allocations are only given back by reset(), unless they are the newest
+    // ------------------------------------------------------------------------
+    void release(void* block)
+    {
+        if (block == nullptr)
+            return;
+        Header* header = (Header*)block - 1;
+        if (header->kind == BLOCK_HEAP)
+        {
+            free(header);
+        }
+        else if (header->kind == BLOCK_LARGE)
+        {
+            for (Large& large : mLarge)
+            {
+                if (large.base == header)
+                    large.used = false;
+            }
+        }
+        else if (header == mLast)
+        {
+            mOffset -= header->capacity;
+            mLast = nullptr;
+        }
+    }
+
+    // turns block into one the heap owns, e.g. the pixels of a decoded image,
+    // so it survives reset() and can be released from any thread
+    // ------------------------------------------------------------------------
+    void* detach(void* block)
+    {
+        Header* header = (Header*)block - 1;
+        if (header->kind == BLOCK_LARGE)
+        {
+            for (size_t i = 0; i < mLarge.size(); ++i)
+            {
+                if (mLarge[i].base == header)
+                {
+                    mReserved -= mLarge[i].capacity;
+                    mLarge.erase(mLarge.begin() + i);
+                    break;
+                }
+            }
+            header->kind = BLOCK_HEAP;
+            return block;
+        }
+        if (header->kind == BLOCK_HEAP)
+            return block;
+        // small enough that a copy costs less than giving up a chunk
+        void* copy = allocateHeap(header->size);
+        if (copy != nullptr)
+            memcpy(copy, block, header->size);
+        release(block);
+        return copy;
+    }
+
+    // forgets every allocation; chunks and large blocks stay for reuse
+    // ------------------------------------------------------------------------
+    void reset()
+    {
+        mChunk = 0;
+        mOffset = 0;
+        mLast = nullptr;
+        for (Large& large : mLarge)
+            large.used = false;
+    }
+
+    // bytes taken from the heap and kept
+    size_t reservedBytes() const { return mReserved; }
+
+    // plain heap allocations with the header the arena's release() expects
+    // ------------------------------------------------------------------------
+    static void* allocateHeap(size_t size)
+    {
+        image_io_detail::countHeapAllocation();
+        Header* header = (Header*)malloc(sizeof(Header) + size);
+        if (header == nullptr)
+            return nullptr;
+        header->size = size;
+        header->capacity = sizeof(Header) + size;
+        header->kind = BLOCK_HEAP;
+        return header + 1;
+    }
+
+    static void* reallocateHeap(void* block, size_t size)
+    {
+        if (block == nullptr)
+            return allocateHeap(size);
+        image_io_detail::countHeapAllocation();
+        Header* header = (Header*)realloc((Header*)block - 1, sizeof(Header) + size);
+        if (header == nullptr)
+            return nullptr;
+        header->size = size;
+        header->capacity = sizeof(Header) + size;
+        return header + 1;
+    }
+
+    // hooks for setImageAllocator: every thread running decodeImage() gets an
+    // arena of its own for as long as the thread lives
+    // ------------------------------------------------------------------------
+    static const ImageAllocator& allocator()
+    {
+        static const ImageAllocator hooks = { hookAllocate, hookReallocate, hookRelease, hookBegin, hookFinish, nullptr };
+        return hooks;
+    }
+
+private:
+    enum BlockKind
+    {
+        BLOCK_HEAP,     // malloc'd on its own, freed with free()
+        BLOCK_BUMP,     // inside a chunk
+        BLOCK_LARGE     // one of mLarge
+    };
+
+    // in front of every block; 16 byte aligned like malloc's own blocks
+    struct alignas(16) Header
+    {
+        size_t size;        // bytes asked for
+        size_t capacity;    // bytes the block takes, this header included
+        int kind;
+    };
+
+    struct Chunk
+    {
+        unsigned char* base;
+        size_t size;
+    };
+
+    struct Large
+    {
+        Header* base;
+        size_t capacity;
+        bool used;
+    };
+
+    static size_t roundUp(size_t size, size_t granule)
+    {
+        return (size + granule - 1) / granule * granule;
+    }
+
+    // the smallest free block that fits, or a new one
+    // ------------------------------------------------------------------------
+    void* allocateLarge(size_t size, size_t total)
+    {
+        Large* best = nullptr;
+        for (Large& large : mLarge)
+        {
+            if (!large.used && large.capacity >= total && (best == nullptr || large.capacity < best->capacity))
+                best = &large;
+        }
+        if (best == nullptr)
+        {
+            Large large;
+            large.capacity = roundUp(total, IMAGE_ARENA_LARGE_GRANULE);
+            large.base = (Header*)malloc(large.capacity);
+            if (large.base == nullptr)
+                return nullptr;
+            large.used = false;
+            mLarge.push_back(large);
+            best = &mLarge.back();
+            reserve(large.capacity);
+        }
+        best->used = true;
+        best->base->size = size;
+        best->base->capacity = best->capacity;
+        best->base->kind = BLOCK_LARGE;
+        return best->base + 1;
+    }
+
+    void reserve(size_t bytes)
+    {
+        image_io_detail::countHeapAllocation();
+        mReserved += bytes;
+        image_io_detail::reportArenaBytes(mReserved);
+    }
+
+    static ImageArena*& current()
+    {
+        static thread_local ImageArena* arena = nullptr;
+        return arena;
+    }
+
+    // the freed heap block a thread without an arena keeps, see the class comment
+    struct Spare
+    {
+        Header* block = nullptr;
+        ~Spare() { free(block); }
+    };
+
+    static Spare& spare()
+    {
+        static thread_local Spare instance;
+        return instance;
+    }
+
+    static void* hookAllocate(size_t size, void*)
+    {
+        ImageArena* arena = current();
+        if (arena)
+            return arena->allocate(size);
+        Header* kept = spare().block;
+        if (kept != nullptr && kept->capacity >= sizeof(Header) + size)
+        {
+            spare().block = nullptr;
+            kept->size = size;
+            return kept + 1;
+        }
+        return allocateHeap(size);
+    }
+
+    static void* hookReallocate(void* block, size_t size, void*)
+    {
+        ImageArena* arena = current();
+        return arena ? arena->reallocate(block, size) : reallocateHeap(block, size);
+    }
+
+    static void hookRelease(void* block, void*)
+    {
+        ImageArena* arena = current();
+        if (arena)
+        {
+            arena->release(block);
+            return;
+        }
+        if (block == nullptr)
+            return;
+        Header* header = (Header*)block - 1;
+        if (header->capacity <= IMAGE_ARENA_SPARE_SIZE + sizeof(Header))
+        {
+            free(spare().block);
+            spare().block = header;
+        }
+        else
+        {
+            free(header);
+        }
+    }
+
+    static void hookBegin(void*)
+    {
+        static thread_local ImageArena arena;
+        current() = &arena;
+    }
+
+    static unsigned char* hookFinish(unsigned char* pixels, size_t, void*)
+    {
+        ImageArena* arena = current();
+        if (pixels != nullptr)
+            pixels = (unsigned char*)arena->detach(pixels);
+        arena->reset();
+        current() = nullptr;
+        return pixels;
+    }
+
+    std::vector<Chunk> mChunks;
+    std::vector<Large> mLarge;
+    size_t mChunk;      // chunk bump allocations come from
+    size_t mOffset;     // first free byte in it
+    Header* mLast;      // newest bump allocation, while it is still live
+    size_t mReserved;
+};
+#endif
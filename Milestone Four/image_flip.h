@@ -0,0 +1,172 @@
+#ifndef IMAGE_FLIP_H
+#define IMAGE_FLIP_H
+
+#include <cstring>
+#include <cstddef>
+
+#include <cpu_features.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_FLIP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Ways of turning an image upside down, fastest available first in
+// FLIP_BEST. The others are kept for --bench-flip.
+enum FlipMethod
+{
+    FLIP_BYTES,     // one byte at a time, the original loop
+    FLIP_MEMCPY,    // whole rows through a small bounce buffer
+    FLIP_SSE2,      // 16 bytes per swap
+    FLIP_AVX2,      // 32 bytes per swap, if the CPU has it
+    FLIP_BEST
+};
+
+inline const char* flipMethodName(FlipMethod method)
+{
+    static const char* const names[] = { "bytes", "memcpy", "sse2", "avx2", "best" };
+    return names[method];
+}
+
+// whether method can run on this build and CPU
+inline bool flipMethodAvailable(FlipMethod method)
+{
+    switch (method)
+    {
+#ifdef IMAGE_FLIP_SSE2
+    case FLIP_SSE2: return true;
+#else
+    case FLIP_SSE2: return false;
+#endif
+#ifdef CPU_X86
+    case FLIP_AVX2: return cpuFeatures().avx2;
+#else
+    case FLIP_AVX2: return false;
+#endif
+    default: return true;
+    }
+}
+
+// exchanges size bytes between two rows
+// ----------------------------------------------------------------------------
+inline void swapRowsBytes(unsigned char* a, unsigned char* b, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        unsigned char tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+inline void swapRowsMemcpy(unsigned char* a, unsigned char* b, size_t size)
+{
+    unsigned char tmp[4096];
+    while (size > 0)
+    {
+        size_t chunk = size < sizeof(tmp) ? size : sizeof(tmp);
+        memcpy(tmp, a, chunk);
+        memcpy(a, b, chunk);
+        memcpy(b, tmp, chunk);
+        a += chunk;
+        b += chunk;
+        size -= chunk;
+    }
+}
+
+#ifdef IMAGE_FLIP_SSE2
+inline void swapRowsSSE2(unsigned char* a, unsigned char* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(a + i + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(a + i + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(a + i + 48));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(b + i + 16));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(b + i + 32));
+        __m128i b3 = _mm_loadu_si128((const __m128i*)(b + i + 48));
+        _mm_storeu_si128((__m128i*)(a + i), b0);
+        _mm_storeu_si128((__m128i*)(a + i + 16), b1);
+        _mm_storeu_si128((__m128i*)(a + i + 32), b2);
+        _mm_storeu_si128((__m128i*)(a + i + 48), b3);
+        _mm_storeu_si128((__m128i*)(b + i), a0);
+        _mm_storeu_si128((__m128i*)(b + i + 16), a1);
+        _mm_storeu_si128((__m128i*)(b + i + 32), a2);
+        _mm_storeu_si128((__m128i*)(b + i + 48), a3);
+    }
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(a + i), vb);
+        _mm_storeu_si128((__m128i*)(b + i), va);
+    }
+    swapRowsBytes(a + i, b + i, size - i);
+}
+#endif
+
+#ifdef CPU_X86
+CPU_TARGET_AVX2 inline void swapRowsAVX2(unsigned char* a, unsigned char* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(a + i + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + i + 32));
+        _mm256_storeu_si256((__m256i*)(a + i), b0);
+        _mm256_storeu_si256((__m256i*)(a + i + 32), b1);
+        _mm256_storeu_si256((__m256i*)(b + i), a0);
+        _mm256_storeu_si256((__m256i*)(b + i + 32), a1);
+    }
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(a + i), vb);
+        _mm256_storeu_si256((__m256i*)(b + i), va);
+    }
+    swapRowsBytes(a + i, b + i, size - i);
+}
+#endif
+
+// Flips an 8-bit image upside down in place by exchanging whole rows,
+// top with bottom, moving inwards
+// ----------------------------------------------------------------------------
+inline void flipImageVertically(unsigned char* image, int width, int height, int channels, FlipMethod method = FLIP_BEST)
+{
+    if (method == FLIP_BEST)
+    {
+        if (flipMethodAvailable(FLIP_AVX2))
+            method = FLIP_AVX2;
+        else if (flipMethodAvailable(FLIP_SSE2))
+            method = FLIP_SSE2;
+        else
+            method = FLIP_MEMCPY;
+    }
+    if (!flipMethodAvailable(method))
+        method = FLIP_MEMCPY;
+
+    const size_t rowBytes = (size_t)width * channels;
+    for (int j = 0; j < height / 2; ++j)
+    {
+        unsigned char* top = image + j * rowBytes;
+        unsigned char* bottom = image + (height - 1 - j) * rowBytes;
+        switch (method)
+        {
+        case FLIP_BYTES: swapRowsBytes(top, bottom, rowBytes); break;
+#ifdef IMAGE_FLIP_SSE2
+        case FLIP_SSE2: swapRowsSSE2(top, bottom, rowBytes); break;
+#endif
+#ifdef CPU_X86
+        case FLIP_AVX2: swapRowsAVX2(top, bottom, rowBytes); break;
+#endif
+        default: swapRowsMemcpy(top, bottom, rowBytes); break;
+        }
+    }
+}
+#endif
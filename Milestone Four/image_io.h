@@ -0,0 +1,295 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <climits>
+#include <atomic>
+#include <chrono>
+
+// The one way images are decoded: stb_image, with its SIMD JPEG kernels and
+// the parallel-for hook. Including this header instead of stb_image.h routes
+// stb_image's allocations through setImageAllocator() and counts them, and
+// decodeImage() probes the header before decoding and keeps decode
+// statistics. Exactly one source file defines IMAGE_IO_IMPLEMENTATION before
+// including it, which compiles stb_image there with these hooks in place.
+
+// Allocation functions stb_image calls; user is passed back unchanged.
+// beginImage and finishImage, if set, run on the decoding thread around
+// every decodeImage(): finishImage gets the decoded pixels (null if it
+// failed) and returns the buffer to hand to the caller, so scratch memory
+// can be recycled between images while the pixels outlive it.
+struct ImageAllocator
+{
+    void* (*allocate)(size_t size, void* user);
+    void* (*reallocate)(void* block, size_t size, void* user);
+    void (*release)(void* block, void* user);
+    void (*beginImage)(void* user);
+    unsigned char* (*finishImage)(unsigned char* pixels, size_t size, void* user);
+    void* user;
+};
+
+// Running totals over every decodeImage() call, see imageDecodeStats()
+struct ImageDecodeStats
+{
+    size_t decoded = 0;         // images decoded
+    size_t failed = 0;          // rejected by the probe or failed to decode
+    size_t inputBytes = 0;      // encoded bytes of the decoded images
+    size_t outputBytes = 0;     // pixel bytes they decoded to
+    double decodeMs = 0.0;      // probe and decode time summed over threads
+    size_t allocations = 0;     // stb_image malloc calls
+    size_t reallocations = 0;   // stb_image realloc calls
+    size_t frees = 0;           // stb_image free calls, decoded images included
+    size_t allocatedBytes = 0;  // bytes asked for by malloc and realloc
+    size_t heapAllocations = 0; // of those, or by the allocator, the ones that reached the heap
+    size_t arenaPeakBytes = 0;  // largest scratch arena, if the allocator reports one
+};
+
+enum ImageFormat
+{
+    IMAGE_UNKNOWN,  // not an image stb_image can read
+    IMAGE_JPEG,
+    IMAGE_PNG,
+    IMAGE_BMP,
+    IMAGE_GIF,
+    IMAGE_OTHER     // readable, but without a signature (TGA) or rarely used
+};
+
+// Images wider or taller than this are refused by the probe, before their
+// pixels are allocated; no GL implementation takes larger textures
+const int IMAGE_MAX_SIDE = 16384;
+
+// What probeImage() reads from an image header
+struct ImageInfo
+{
+    ImageFormat format = IMAGE_UNKNOWN;
+    int width = 0;
+    int height = 0;
+    int channels = 0;               // in the file, decoding may ask for others
+    const char* error = nullptr;    // why the probe or the decode failed
+};
+
+namespace image_io_detail
+{
+    struct Counters
+    {
+        std::atomic<size_t> decoded{ 0 };
+        std::atomic<size_t> failed{ 0 };
+        std::atomic<size_t> inputBytes{ 0 };
+        std::atomic<size_t> outputBytes{ 0 };
+        std::atomic<long long> decodeNs{ 0 };
+        std::atomic<size_t> allocations{ 0 };
+        std::atomic<size_t> reallocations{ 0 };
+        std::atomic<size_t> frees{ 0 };
+        std::atomic<size_t> allocatedBytes{ 0 };
+        std::atomic<size_t> heapAllocations{ 0 };
+        std::atomic<size_t> arenaPeakBytes{ 0 };
+    };
+
+    inline Counters& counters()
+    {
+        static Counters instance;
+        return instance;
+    }
+
+    // null: the C runtime's malloc, realloc and free
+    inline const ImageAllocator*& allocator()
+    {
+        static const ImageAllocator* instance = nullptr;
+        return instance;
+    }
+
+    inline void* allocate(size_t size)
+    {
+        counters().allocations.fetch_add(1, std::memory_order_relaxed);
+        counters().allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        const ImageAllocator* hooks = allocator();
+        if (hooks)
+            return hooks->allocate(size, hooks->user);
+        counters().heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        return malloc(size);
+    }
+
+    inline void* reallocate(void* block, size_t size)
+    {
+        counters().reallocations.fetch_add(1, std::memory_order_relaxed);
+        counters().allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        const ImageAllocator* hooks = allocator();
+        if (hooks)
+            return hooks->reallocate(block, size, hooks->user);
+        counters().heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        return realloc(block, size);
+    }
+
+    // for allocators: a call they passed on to the heap, and their arena size
+    inline void countHeapAllocation()
+    {
+        counters().heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void reportArenaBytes(size_t bytes)
+    {
+        size_t peak = counters().arenaPeakBytes.load(std::memory_order_relaxed);
+        while (bytes > peak && !counters().arenaPeakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    inline void release(void* block)
+    {
+        if (block == nullptr)
+            return;
+        counters().frees.fetch_add(1, std::memory_order_relaxed);
+        const ImageAllocator* hooks = allocator();
+        if (hooks)
+            hooks->release(block, hooks->user);
+        else
+            free(block);
+    }
+
+    // the format by its signature; stbi_info tells whether it is readable
+    inline ImageFormat sniff(const unsigned char* data, size_t size)
+    {
+        if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+            return IMAGE_JPEG;
+        if (size >= 8 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G')
+            return IMAGE_PNG;
+        if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+            return IMAGE_BMP;
+        if (size >= 4 && data[0] == 'G' && data[1] == 'I' && data[2] == 'F' && data[3] == '8')
+            return IMAGE_GIF;
+        return IMAGE_OTHER;
+    }
+}
+
+#define STBI_MALLOC(size)           image_io_detail::allocate(size)
+#define STBI_REALLOC(block, size)   image_io_detail::reallocate(block, size)
+#define STBI_FREE(block)            image_io_detail::release(block)
+#include <stb_image.h>
+
+// Replaces the allocation functions; null goes back to malloc. Images that
+// are still alive are freed with the functions that allocated them, so this
+// may only be called while no image is being decoded or held.
+inline void setImageAllocator(const ImageAllocator* allocator)
+{
+    image_io_detail::allocator() = allocator;
+}
+
+// Reads width, height and channel count from the header without decoding.
+// False if stb_image cannot read the data or it is too large to decode.
+inline bool probeImage(const unsigned char* data, size_t size, ImageInfo& info)
+{
+    info = ImageInfo();
+    if (data == nullptr || size == 0 || size > INT_MAX)
+    {
+        info.error = "empty or larger than 2 GB";
+        return false;
+    }
+    if (!stbi_info_from_memory(data, (int)size, &info.width, &info.height, &info.channels))
+    {
+        info.error = stbi_failure_reason();
+        return false;
+    }
+    if (info.width > IMAGE_MAX_SIDE || info.height > IMAGE_MAX_SIDE)
+    {
+        info.error = "larger than IMAGE_MAX_SIDE";
+        return false;
+    }
+    info.format = image_io_detail::sniff(data, size);
+    return true;
+}
+
+// Probes and decodes an image into 8 bits per channel, with channels
+// channels or, for 0, as many as the file has. Returns null on failure
+// with the reason in info.error; free the pixels with freeImage().
+inline unsigned char* decodeImage(const unsigned char* data, size_t size, ImageInfo& info, int channels = 0)
+{
+    image_io_detail::Counters& counters = image_io_detail::counters();
+    const ImageAllocator* hooks = image_io_detail::allocator();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (hooks && hooks->beginImage)
+        hooks->beginImage(hooks->user);
+    unsigned char* pixels = nullptr;
+    if (probeImage(data, size, info))
+    {
+        int width, height, fileChannels;
+        pixels = stbi_load_from_memory(data, (int)size, &width, &height, &fileChannels, channels);
+        if (pixels == nullptr)
+            info.error = stbi_failure_reason();
+    }
+    if (hooks && hooks->finishImage)
+        pixels = hooks->finishImage(pixels, pixels ? (size_t)info.width * info.height * (channels ? channels : info.channels) : 0, hooks->user);
+    counters.decodeNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+    if (pixels == nullptr)
+    {
+        counters.failed.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    counters.decoded.fetch_add(1, std::memory_order_relaxed);
+    counters.inputBytes.fetch_add(size, std::memory_order_relaxed);
+    counters.outputBytes.fetch_add((size_t)info.width * info.height * (channels ? channels : info.channels),
+        std::memory_order_relaxed);
+    return pixels;
+}
+
+inline void freeImage(unsigned char* pixels)
+{
+    stbi_image_free(pixels);
+}
+
+inline ImageDecodeStats imageDecodeStats()
+{
+    const image_io_detail::Counters& counters = image_io_detail::counters();
+    ImageDecodeStats stats;
+    stats.decoded = counters.decoded;
+    stats.failed = counters.failed;
+    stats.inputBytes = counters.inputBytes;
+    stats.outputBytes = counters.outputBytes;
+    stats.decodeMs = counters.decodeNs / 1e6;
+    stats.allocations = counters.allocations;
+    stats.reallocations = counters.reallocations;
+    stats.frees = counters.frees;
+    stats.allocatedBytes = counters.allocatedBytes;
+    stats.heapAllocations = counters.heapAllocations;
+    stats.arenaPeakBytes = counters.arenaPeakBytes;
+    return stats;
+}
+
+inline void resetImageDecodeStats()
+{
+    image_io_detail::Counters& counters = image_io_detail::counters();
+    counters.decoded = 0;
+    counters.failed = 0;
+    counters.inputBytes = 0;
+    counters.outputBytes = 0;
+    counters.decodeNs = 0;
+    counters.allocations = 0;
+    counters.reallocations = 0;
+    counters.frees = 0;
+    counters.allocatedBytes = 0;
+    counters.heapAllocations = 0;
+    counters.arenaPeakBytes = 0;
+}
+
+inline const char* imageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case IMAGE_JPEG: return "JPEG";
+    case IMAGE_PNG: return "PNG";
+    case IMAGE_BMP: return "BMP";
+    case IMAGE_GIF: return "GIF";
+    case IMAGE_OTHER: return "other";
+    default: return "unknown";
+    }
+}
+#endif
+
+// stb_image's implementation, compiled once with the hooks above
+#if defined(IMAGE_IO_IMPLEMENTATION) && !defined(IMAGE_IO_IMPLEMENTED)
+#define IMAGE_IO_IMPLEMENTED
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#endif
@@ -0,0 +1,119 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only into memory (mmap, or CreateFileMapping on
+// Windows). Pages are read from disk on first touch, so nothing is copied
+// up front and unused parts of the file are never read.
+class MappedFile
+{
+public:
+    MappedFile() : mData(nullptr), mSize(0)
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // maps path, returns false if it does not exist, is empty or cannot be mapped
+    // ------------------------------------------------------------------------
+    bool open(const char* path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return false;
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        // the view keeps the mapping alive
+        CloseHandle(mapping);
+        if (view == nullptr)
+            return false;
+        mData = static_cast<const unsigned char*>(view);
+        mSize = (size_t)size.QuadPart;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file alive
+        ::close(fd);
+        if (view == MAP_FAILED)
+            return false;
+        mData = static_cast<const unsigned char*>(view);
+        mSize = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void close()
+    {
+        if (mData == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(mData);
+#else
+        munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    // tells the OS the mapping will be read once from front to back, so it
+    // reads ahead aggressively and drops pages behind the reader. Windows
+    // gets the same hint from FILE_FLAG_SEQUENTIAL_SCAN in open().
+    // ------------------------------------------------------------------------
+    void adviseSequential() const
+    {
+#ifndef _WIN32
+        if (mData != nullptr)
+            madvise(const_cast<unsigned char*>(mData), mSize, MADV_SEQUENTIAL);
+#endif
+    }
+
+    const unsigned char* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const unsigned char* mData;
+    size_t mSize;
+};
+#endif
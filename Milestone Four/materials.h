@@ -0,0 +1,415 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <render_stats.h>
+#include <pixel_upload_ring.h>
+#include <thread_pool.h>
+
+// Every material's diffuse texture, one layer each, in a single
+// GL_TEXTURE_2D_ARRAY. The whole scene samples it through one binding, so
+// adding materials never adds texture binds. Layers all share one size;
+// images of another size are resampled on the CPU before upload. The array is
+// either plain GL_RGB8 or one block-compressed format for every layer.
+
+// Reconstruction filters for MaterialArray::resample
+enum ResampleFilter
+{
+    RESAMPLE_BOX,       // average of the source pixels under each output pixel
+    RESAMPLE_TENT,      // linear falloff, bilinear when enlarging
+    RESAMPLE_LANCZOS    // windowed sinc over 3 lobes, sharpest when shrinking
+};
+
+class MaterialArray
+{
+public:
+    MaterialArray() : mTexture(0), mFormat(GL_RGB8), mWidth(0), mHeight(0), mLayers(0), mLevels(0), mUsed(0)
+    {
+    }
+
+    // allocates immutable storage with a full mip chain for layers layers
+    // ------------------------------------------------------------------------
+    void create(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat = GL_RGB8)
+    {
+        mFormat = internalFormat;
+        mWidth = width;
+        mHeight = height;
+        mLayers = layers;
+        mUsed = 0;
+
+        mLevels = 1;
+        while ((width >> mLevels) > 0 || (height >> mLevels) > 0)
+            ++mLevels;
+
+        glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, mLevels, mFormat, width, height, layers);
+
+        // set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // set texture filtering parameters
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // uploads an 8-bit RGB or RGBA image into the next free layer, resampling
+    // it to the layer size first if needed. Returns the layer, or -1 on failure.
+    // ------------------------------------------------------------------------
+    int add(const unsigned char* pixels, int width, int height, int channels)
+    {
+        return upload(mUsed, pixels, width, height, channels);
+    }
+
+    // same as add() but into the given layer, for images that arrive out of
+    // order. With a staging ring the image is streamed through it in tiles of
+    // whole rows instead of being handed to GL from client memory in one piece.
+    // ------------------------------------------------------------------------
+    int upload(GLsizei layer, const unsigned char* pixels, int width, int height, int channels,
+        PixelUploadRing* staging = nullptr)
+    {
+        if (layer < 0 || layer >= mLayers)
+        {
+            std::cout << "ERROR::MATERIALS::NO_FREE_LAYER" << std::endl;
+            return -1;
+        }
+        if (channels != 3 && channels != 4)
+        {
+            std::cout << "ERROR::MATERIALS::UNSUPPORTED_CHANNELS: " << channels << std::endl;
+            return -1;
+        }
+        if (compressed())
+        {
+            std::cout << "ERROR::MATERIALS::COMPRESSED_ARRAY_NEEDS_BLOCKS" << std::endl;
+            return -1;
+        }
+
+        std::vector<unsigned char> resampled;
+        if (width != mWidth || height != mHeight)
+        {
+            resampled.resize((size_t)mWidth * mHeight * channels);
+            resample(pixels, width, height, channels, resampled.data(), mWidth, mHeight);
+            pixels = resampled.data();
+        }
+
+        return uploadLevel(layer, 0, pixels, channels, staging) ? layer : -1;
+    }
+
+    // uploads one mip level of a layer from pixels already at that level's
+    // size, for mip chains built ahead of time
+    // ------------------------------------------------------------------------
+    bool uploadLevel(GLsizei layer, GLint level, const unsigned char* pixels, int channels,
+        PixelUploadRing* staging = nullptr)
+    {
+        if (layer < 0 || layer >= mLayers || level < 0 || level >= mLevels || (channels != 3 && channels != 4) || compressed())
+        {
+            std::cout << "ERROR::MATERIALS::INVALID_LEVEL: layer " << layer << ", level " << level << std::endl;
+            return false;
+        }
+        const GLsizei width = mWidth >> level > 0 ? mWidth >> level : 1;
+        const GLsizei height = mHeight >> level > 0 ? mHeight >> level : 1;
+
+        const GLenum format = channels == 4 ? GL_RGBA : GL_RGB;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (staging != nullptr)
+        {
+            const size_t rowBytes = (size_t)width * channels;
+            GLsizei tileRows = (GLsizei)(staging->slotSize() / rowBytes);
+            if (tileRows < 1)
+                tileRows = 1;
+
+            staging->bind();
+            for (GLsizei y = 0; y < height; y += tileRows)
+            {
+                GLsizei rows = height - y < tileRows ? height - y : tileRows;
+                GLintptr offset;
+                unsigned char* tile = staging->acquire(offset);
+                memcpy(tile, pixels + y * rowBytes, rows * rowBytes);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, layer, width, rows, 1,
+                    format, GL_UNSIGNED_BYTE, (const void*)offset);
+                staging->release();
+            }
+            staging->unbind();
+        }
+        else
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+                format, GL_UNSIGNED_BYTE, pixels);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        if (layer >= mUsed)
+            mUsed = layer + 1;
+        return true;
+    }
+
+    // uploads one mip level of a layer as compressed blocks in the array's
+    // format, streamed through the staging ring in tiles of whole block rows
+    // ------------------------------------------------------------------------
+    bool uploadCompressedLevel(GLsizei layer, GLint level, const unsigned char* blocks, size_t size,
+        PixelUploadRing* staging = nullptr)
+    {
+        const size_t blockSize = compressedBlockBytes(mFormat);
+        if (blockSize == 0 || layer < 0 || layer >= mLayers || level < 0 || level >= mLevels)
+        {
+            std::cout << "ERROR::MATERIALS::INVALID_LEVEL: layer " << layer << ", level " << level << std::endl;
+            return false;
+        }
+        const GLsizei width = mWidth >> level > 0 ? mWidth >> level : 1;
+        const GLsizei height = mHeight >> level > 0 ? mHeight >> level : 1;
+        const size_t rowBytes = (size_t)((width + 3) / 4) * blockSize;
+        const GLsizei blockRows = (height + 3) / 4;
+        if (size != rowBytes * blockRows)
+        {
+            std::cout << "ERROR::MATERIALS::WRONG_COMPRESSED_SIZE: " << size << std::endl;
+            return false;
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        if (staging != nullptr)
+        {
+            GLsizei tileRows = (GLsizei)(staging->slotSize() / rowBytes);
+            if (tileRows < 1)
+                tileRows = 1;
+
+            staging->bind();
+            for (GLsizei row = 0; row < blockRows; row += tileRows)
+            {
+                GLsizei rows = blockRows - row < tileRows ? blockRows - row : tileRows;
+                // tiles start on block rows; only the last one may end inside a block
+                GLsizei y = row * 4;
+                GLsizei tileHeight = height - y < rows * 4 ? height - y : rows * 4;
+                GLintptr offset;
+                unsigned char* tile = staging->acquire(offset);
+                memcpy(tile, blocks + row * rowBytes, rows * rowBytes);
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, layer, width, tileHeight, 1,
+                    mFormat, (GLsizei)(rows * rowBytes), (const void*)offset);
+                staging->release();
+            }
+            staging->unbind();
+        }
+        else
+        {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1,
+                mFormat, (GLsizei)size, blocks);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        if (layer >= mUsed)
+            mUsed = layer + 1;
+        return true;
+    }
+
+    // builds the mip chain of every layer once all layers are uploaded; not
+    // possible for compressed arrays, whose levels must all be uploaded
+    // ------------------------------------------------------------------------
+    void generateMipmaps()
+    {
+        if (compressed())
+            return;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // ------------------------------------------------------------------------
+    void bind(GLuint unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        ++renderStats().textureBinds;
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        glDeleteTextures(1, &mTexture);
+        mTexture = 0;
+        mUsed = 0;
+    }
+
+    GLsizei layerWidth() const { return mWidth; }
+    GLsizei layerHeight() const { return mHeight; }
+    GLsizei layerCount() const { return mUsed; }   // highest filled layer + 1
+    GLsizei levelCount() const { return mLevels; }
+    GLenum internalFormat() const { return mFormat; }
+    bool compressed() const { return compressedBlockBytes(mFormat) != 0; }
+
+    // bytes of texture memory the array takes, all layers and levels
+    size_t memoryBytes() const { return storageBytes(mFormat, mWidth, mHeight, mLayers); }
+
+    // bytes of texture memory layers layers of a format take with full mip chains
+    // ------------------------------------------------------------------------
+    static size_t storageBytes(GLenum format, GLsizei width, GLsizei height, GLsizei layers)
+    {
+        const size_t blockSize = compressedBlockBytes(format);
+        size_t bytes = 0;
+        for (GLsizei level = 0; (width >> level) > 0 || (height >> level) > 0; ++level)
+        {
+            size_t w = width >> level > 0 ? width >> level : 1;
+            size_t h = height >> level > 0 ? height >> level : 1;
+            if (blockSize != 0)
+                bytes += ((w + 3) / 4) * ((h + 3) / 4) * blockSize;
+            else
+                bytes += w * h * (format == GL_RGBA8 ? 4 : 3);
+        }
+        return bytes * layers;
+    }
+
+    // separable resample: each pass spreads its rows over the shared thread
+    // pool. Filters widen to the whole source footprint when
+    // shrinking, so detail is averaged rather than skipped.
+    // ------------------------------------------------------------------------
+    static void resample(const unsigned char* src, int srcWidth, int srcHeight, int channels,
+        unsigned char* dst, int dstWidth, int dstHeight, ResampleFilter filter = RESAMPLE_TENT)
+    {
+        // horizontal pass into a float buffer, then vertical pass into dst
+        std::vector<float> rows((size_t)dstWidth * srcHeight * channels);
+        std::vector<Tap> taps;
+        std::vector<size_t> first;
+
+        buildTaps(srcWidth, dstWidth, filter, taps, first);
+        parallelRows(srcHeight, [&](int y)
+        {
+            const unsigned char* in = src + (size_t)y * srcWidth * channels;
+            float* out = &rows[(size_t)y * dstWidth * channels];
+            for (int x = 0; x < dstWidth; ++x)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    float sum = 0.0f;
+                    for (size_t t = first[x]; t < first[x + 1]; ++t)
+                        sum += taps[t].weight * in[taps[t].index * channels + c];
+                    out[x * channels + c] = sum;
+                }
+            }
+        });
+
+        std::vector<Tap> columnTaps;
+        std::vector<size_t> columnFirst;
+        buildTaps(srcHeight, dstHeight, filter, columnTaps, columnFirst);
+        const size_t rowStride = (size_t)dstWidth * channels;
+        parallelRows(dstHeight, [&](int y)
+        {
+            unsigned char* out = dst + y * rowStride;
+            for (size_t i = 0; i < rowStride; ++i)
+            {
+                float sum = 0.0f;
+                for (size_t t = columnFirst[y]; t < columnFirst[y + 1]; ++t)
+                    sum += columnTaps[t].weight * rows[columnTaps[t].index * rowStride + i];
+                sum += 0.5f;
+                out[i] = (unsigned char)(sum < 0.0f ? 0.0f : (sum > 255.0f ? 255.0f : sum));
+            }
+        });
+    }
+
+private:
+    // bytes per 4x4 block of a format, 0 if it is not compressed
+    static size_t compressedBlockBytes(GLenum format)
+    {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return 8;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: return 16;
+        default: return 0;
+        }
+    }
+
+    struct Tap
+    {
+        int index;
+        float weight;
+    };
+
+    // normalized filter weights for every output sample of a 1D resample;
+    // taps of output i are taps[first[i]] up to taps[first[i + 1]]
+    // ------------------------------------------------------------------------
+    static void buildTaps(int srcSize, int dstSize, ResampleFilter filter, std::vector<Tap>& taps, std::vector<size_t>& first)
+    {
+        taps.clear();
+        first.assign(1, 0);
+        float scale = (float)srcSize / dstSize;
+        float stretch = scale > 1.0f ? scale : 1.0f;
+        // reach of the filter in source pixels
+        float radius = filter == RESAMPLE_LANCZOS ? 3.0f * stretch : (filter == RESAMPLE_BOX ? 0.5f * stretch : stretch);
+        for (int i = 0; i < dstSize; ++i)
+        {
+            float center = (i + 0.5f) * scale;
+            int lo = (int)std::floor(center - radius);
+            int hi = (int)std::ceil(center + radius);
+            float total = 0.0f;
+            size_t start = taps.size();
+            for (int s = lo; s <= hi; ++s)
+            {
+                float weight = filterWeight(filter, s, center, radius, stretch);
+                if (weight == 0.0f)
+                    continue;
+                Tap tap;
+                tap.index = s < 0 ? 0 : (s >= srcSize ? srcSize - 1 : s);
+                tap.weight = weight;
+                taps.push_back(tap);
+                total += weight;
+            }
+            for (size_t t = start; t < taps.size(); ++t)
+                taps[t].weight /= total;
+            first.push_back(taps.size());
+        }
+    }
+
+    // unnormalized weight of source pixel s for an output sample at center
+    // ------------------------------------------------------------------------
+    static float filterWeight(ResampleFilter filter, int s, float center, float radius, float stretch)
+    {
+        const float pi = 3.14159265358979f;
+        switch (filter)
+        {
+        case RESAMPLE_BOX:
+        {
+            // how much of the pixel [s, s + 1] the output pixel covers
+            float lo = s > center - radius ? (float)s : center - radius;
+            float hi = s + 1 < center + radius ? (float)(s + 1) : center + radius;
+            return hi > lo ? hi - lo : 0.0f;
+        }
+        case RESAMPLE_LANCZOS:
+        {
+            float x = (s + 0.5f - center) / stretch;
+            if (std::fabs(x) >= 3.0f)
+                return 0.0f;
+            if (std::fabs(x) < 1e-5f)
+                return 1.0f;
+            return 3.0f * std::sin(pi * x) * std::sin(pi * x / 3.0f) / (pi * pi * x * x);
+        }
+        default:
+        {
+            float weight = 1.0f - std::fabs((s + 0.5f - center) / radius);
+            return weight > 0.0f ? weight : 0.0f;
+        }
+        }
+    }
+
+    // runs row(y) for every y below count on the shared thread pool
+    // ------------------------------------------------------------------------
+    template <typename Row>
+    static void parallelRows(int count, const Row& row)
+    {
+        sharedThreadPool().parallelFor(count, [&](int begin, int end)
+        {
+            for (int y = begin; y < end; ++y)
+                row(y);
+        }, 8);
+    }
+
+    GLuint mTexture;
+    GLenum mFormat;
+    GLsizei mWidth;
+    GLsizei mHeight;
+    GLsizei mLayers;
+    GLsizei mLevels;
+    GLsizei mUsed;
+};
+#endif
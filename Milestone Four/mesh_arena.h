@@ -0,0 +1,107 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <vector>
+
+#include <render_stats.h>
+
+// The range of the shared mesh arena that a given mesh occupies
+struct GLMesh
+{
+    GLint baseVertex;   // added to every index before fetching a vertex
+    GLuint firstIndex;  // offset of the mesh's first index in the index buffer
+    GLuint nIndices;    // Number of indices of the mesh
+};
+
+// Collects the geometry of every mesh into one vertex buffer and one index
+// buffer behind a single VAO. Each mesh adds its own range of vertices and
+// indexes it through its baseVertex.
+class MeshArena
+{
+public:
+    explicit MeshArena(GLsizei stride = 0) : mStride(stride), mVao(0), mVertexCount(0), mVertexBytes(0), mIndexBytes(0)
+    {
+        mBuffers[0] = mBuffers[1] = 0;
+    }
+
+    // size in bytes of one vertex, must be set before any vertices are added
+    // ------------------------------------------------------------------------
+    void setStride(GLsizei stride)
+    {
+        mStride = stride;
+    }
+
+    // appends count vertices, returns the base vertex for meshes indexing them
+    // ------------------------------------------------------------------------
+    GLint addVertices(const void* vertices, GLuint count)
+    {
+        GLint baseVertex = (GLint)mVertexCount;
+        const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+        mVertices.insert(mVertices.end(), bytes, bytes + (size_t)count * mStride);
+        mVertexCount += count;
+        return baseVertex;
+    }
+
+    // appends an index list relative to baseVertex and returns the mesh range
+    // ------------------------------------------------------------------------
+    GLMesh addMesh(GLint baseVertex, const GLushort* indices, GLuint count)
+    {
+        GLMesh mesh;
+        mesh.baseVertex = baseVertex;
+        mesh.firstIndex = (GLuint)mIndices.size();
+        mesh.nIndices = count;
+        mIndices.insert(mIndices.end(), indices, indices + count);
+        return mesh;
+    }
+
+    // creates the GL buffers and leaves the VAO bound so the caller can describe
+    // the vertex attributes. The CPU copies are released afterwards.
+    // ------------------------------------------------------------------------
+    void upload()
+    {
+        glGenVertexArrays(1, &mVao);
+        glBindVertexArray(mVao);
+
+        glGenBuffers(2, mBuffers);
+        glBindBuffer(GL_ARRAY_BUFFER, mBuffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, mVertices.size(), mVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBuffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(GLushort), mIndices.data(), GL_STATIC_DRAW);
+
+        mVertexBytes = mVertices.size();
+        mIndexBytes = mIndices.size() * sizeof(GLushort);
+        std::vector<unsigned char>().swap(mVertices);
+        std::vector<GLushort>().swap(mIndices);
+    }
+
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        glBindVertexArray(mVao);
+        ++renderStats().vertexArrayBinds;
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(2, mBuffers);
+        mVao = 0;
+        mBuffers[0] = mBuffers[1] = 0;
+    }
+
+    // bytes of GPU memory held by the vertex and index buffers
+    size_t vertexBytes() const { return mVertexBytes; }
+    size_t indexBytes() const { return mIndexBytes; }
+
+private:
+    GLsizei mStride;
+    GLuint mVao;
+    GLuint mBuffers[2];                     // vertex buffer, index buffer
+    GLuint mVertexCount;
+    size_t mVertexBytes;
+    size_t mIndexBytes;
+    std::vector<unsigned char> mVertices;   // staged until upload()
+    std::vector<GLushort> mIndices;         // staged until upload()
+};
+#endif
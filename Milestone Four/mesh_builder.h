@@ -0,0 +1,273 @@
+#ifndef MESH_BUILDER_H
+#define MESH_BUILDER_H
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+
+#include <vertex_format.h>
+
+enum NormalMode
+{
+    NORMALS_GENERATED,  // as the geometry came, only tangents are computed
+    NORMALS_FLAT,       // one normal per face; vertices on a crease are split
+    NORMALS_SMOOTH      // area weighted average of the faces around each shared vertex
+};
+
+// One mesh: its own vertices and the triangles indexing them, wound
+// counter-clockwise seen from the front
+struct BuiltMesh
+{
+    std::vector<SourceVertex> vertices;
+    std::vector<GLushort> indices;
+};
+
+namespace mesh_builder_detail
+{
+    inline void subtract(const float* a, const float* b, float* out)
+    {
+        out[0] = a[0] - b[0];
+        out[1] = a[1] - b[1];
+        out[2] = a[2] - b[2];
+    }
+
+    inline void cross(const float* a, const float* b, float* out)
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline float dot(const float* a, const float* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // false, leaving v alone, if it is too short to have a direction
+    inline bool normalize(float* v)
+    {
+        float length = std::sqrt(dot(v, v));
+        if (length < 1e-12f)
+            return false;
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+        return true;
+    }
+
+    // normal of a counter-clockwise triangle, scaled by twice its area
+    inline void faceNormal(const float* p0, const float* p1, const float* p2, float* normal)
+    {
+        float e1[3], e2[3];
+        subtract(p1, p0, e1);
+        subtract(p2, p0, e2);
+        cross(e1, e2, normal);
+    }
+
+    // Accumulates the direction of increasing u and v of a triangle into the
+    // tangents (xyz) and bitangents of its vertices
+    inline void addTangents(std::vector<SourceVertex>& vertices, std::vector<float>& bitangents, const GLushort* corners)
+    {
+        const SourceVertex& a = vertices[corners[0]];
+        const SourceVertex& b = vertices[corners[1]];
+        const SourceVertex& c = vertices[corners[2]];
+        float e1[3], e2[3];
+        subtract(b.position, a.position, e1);
+        subtract(c.position, a.position, e2);
+        const float du1 = b.uv[0] - a.uv[0], dv1 = b.uv[1] - a.uv[1];
+        const float du2 = c.uv[0] - a.uv[0], dv2 = c.uv[1] - a.uv[1];
+        const float determinant = du1 * dv2 - du2 * dv1;
+        if (std::fabs(determinant) < 1e-12f)
+            return;     // no texture mapping across the face
+        const float r = 1.0f / determinant;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            SourceVertex& vertex = vertices[corners[corner]];
+            float* bitangent = &bitangents[corners[corner] * 3];
+            for (int i = 0; i < 3; ++i)
+            {
+                vertex.tangent[i] += (e1[i] * dv2 - e2[i] * dv1) * r;
+                bitangent[i] += (e2[i] * du1 - e1[i] * du2) * r;
+            }
+        }
+    }
+
+    // Makes the accumulated tangents unit length and perpendicular to the
+    // normals, with the bitangent's side in w. Vertices without texture
+    // mapping get any tangent perpendicular to their normal.
+    inline void finishTangents(std::vector<SourceVertex>& vertices, const std::vector<float>& bitangents)
+    {
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            SourceVertex& vertex = vertices[v];
+            const float* n = vertex.normal;
+            float* t = vertex.tangent;
+            const float along = dot(n, t);
+            for (int i = 0; i < 3; ++i)
+                t[i] -= n[i] * along;
+            if (!normalize(t))
+            {
+                const float axis[3] = { std::fabs(n[0]) < 0.9f ? 1.0f : 0.0f, std::fabs(n[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+                const float projection = dot(n, axis);
+                for (int i = 0; i < 3; ++i)
+                    t[i] = axis[i] - n[i] * projection;
+                normalize(t);
+            }
+            float side[3];
+            cross(n, t, side);
+            t[3] = dot(side, &bitangents[v * 3]) < 0.0f ? -1.0f : 1.0f;
+        }
+    }
+}
+
+// Builds a mesh out of a vertex table and the triangles indexing it: copies
+// the vertices the triangles use, gives them normals as mode says, and
+// computes their tangents from the texture coordinates
+// ----------------------------------------------------------------------------
+inline void buildMesh(const SourceVertex* table, size_t tableSize, const GLushort* indices, size_t count,
+    NormalMode mode, BuiltMesh& mesh)
+{
+    using namespace mesh_builder_detail;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    const size_t triangles = count / 3;
+
+    // table index -> first vertex copied from it; with flat normals the
+    // copies of one table vertex form a chain through next
+    const GLushort NONE = 0xFFFF;
+    std::vector<GLushort> first(tableSize, NONE);
+    std::vector<GLushort> next;
+    mesh.vertices.reserve(tableSize);
+    mesh.indices.reserve(triangles * 3);
+
+    for (size_t t = 0; t < triangles; ++t)
+    {
+        const GLushort* corners = indices + t * 3;
+        if (corners[0] >= tableSize || corners[1] >= tableSize || corners[2] >= tableSize)
+            continue;
+        float normal[3];
+        faceNormal(table[corners[0]].position, table[corners[1]].position, table[corners[2]].position, normal);
+        float unit[3] = { normal[0], normal[1], normal[2] };
+        if (!normalize(unit))
+            continue;   // degenerate, nothing to draw
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const GLushort source = corners[corner];
+            GLushort vertex = first[source];
+            if (mode == NORMALS_FLAT)
+            {
+                // reuse a copy lying in the same plane, coplanar faces share it
+                while (vertex != NONE && dot(mesh.vertices[vertex].normal, unit) < 0.9999f)
+                    vertex = next[vertex];
+            }
+            if (vertex == NONE)
+            {
+                vertex = (GLushort)mesh.vertices.size();
+                SourceVertex copy = table[source];
+                if (mode != NORMALS_GENERATED)
+                {
+                    for (int k = 0; k < 3; ++k)
+                        copy.normal[k] = mode == NORMALS_FLAT ? unit[k] : 0.0f;
+                }
+                for (int k = 0; k < 4; ++k)
+                    copy.tangent[k] = 0.0f;
+                mesh.vertices.push_back(copy);
+                next.push_back(first[source]);
+                first[source] = vertex;
+            }
+            if (mode == NORMALS_SMOOTH)
+            {
+                for (int k = 0; k < 3; ++k)
+                    mesh.vertices[vertex].normal[k] += normal[k];
+            }
+            mesh.indices.push_back(vertex);
+        }
+    }
+
+    if (mode == NORMALS_SMOOTH)
+    {
+        for (SourceVertex& vertex : mesh.vertices)
+        {
+            if (!normalize(vertex.normal))
+            {
+                vertex.normal[0] = vertex.normal[2] = 0.0f;
+                vertex.normal[1] = 1.0f;
+            }
+        }
+    }
+    std::vector<float> bitangents(mesh.vertices.size() * 3, 0.0f);
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        addTangents(mesh.vertices, bitangents, &mesh.indices[i]);
+    finishTangents(mesh.vertices, bitangents);
+}
+
+// Generates meshes and builds their normals and tangents on a thread of its
+// own, so they are ready by the time the GL context and textures are
+class MeshBuilder
+{
+public:
+    // fills in the vertices and indices of every mesh, see buildMesh()
+    typedef std::function<void(std::vector<BuiltMesh>&)> GenerateFunction;
+
+    MeshBuilder() : mMode(NORMALS_GENERATED), mBuildMs(0.0)
+    {
+    }
+
+    ~MeshBuilder()
+    {
+        if (mWorker.joinable())
+            mWorker.join();
+    }
+
+    MeshBuilder(const MeshBuilder&) = delete;
+    MeshBuilder& operator=(const MeshBuilder&) = delete;
+
+    // starts generating the meshes and building them
+    // ------------------------------------------------------------------------
+    void start(GenerateFunction generate, NormalMode mode)
+    {
+        if (mWorker.joinable())
+            mWorker.join();
+        mGenerate = generate;
+        mMode = mode;
+        mWorker = std::thread(&MeshBuilder::work, this);
+    }
+
+    // waits for the meshes, in the order generate made them
+    // ------------------------------------------------------------------------
+    std::vector<BuiltMesh>& wait()
+    {
+        if (mWorker.joinable())
+            mWorker.join();
+        return mMeshes;
+    }
+
+    // time the worker spent generating and building
+    double buildMs() const { return mBuildMs; }
+
+private:
+    void work()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<BuiltMesh> generated;
+        mGenerate(generated);
+        mMeshes.resize(generated.size());
+        for (size_t i = 0; i < generated.size(); ++i)
+        {
+            const BuiltMesh& source = generated[i];
+            buildMesh(source.vertices.data(), source.vertices.size(), source.indices.data(), source.indices.size(),
+                mMode, mMeshes[i]);
+        }
+        mBuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    GenerateFunction mGenerate;
+    NormalMode mMode;
+    std::vector<BuiltMesh> mMeshes;
+    double mBuildMs;
+    std::thread mWorker;
+};
+#endif
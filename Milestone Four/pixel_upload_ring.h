@@ -0,0 +1,124 @@
+#ifndef PIXEL_UPLOAD_RING_H
+#define PIXEL_UPLOAD_RING_H
+
+#include <iostream>
+#include <chrono>
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER split into fixed-size slots
+// for streaming texture data. Pixels are copied into a slot and the texture
+// update reads them from there, so glTexSubImage returns at once instead of
+// copying the whole image out of client memory first. A fence per slot keeps
+// a slot from being overwritten before the GPU has read it.
+// Requires GL 4.4 (or ARB_buffer_storage).
+class PixelUploadRing
+{
+public:
+    static const unsigned int MAX_SLOTS = 8;
+
+    PixelUploadRing() : mBuffer(0), mMapped(nullptr), mSlotSize(0), mSlots(0), mCurrent(0), mWaitMs(0.0)
+    {
+        for (unsigned int i = 0; i < MAX_SLOTS; ++i)
+            mFences[i] = 0;
+    }
+
+    // allocates slots slots of slotSize bytes each
+    // ------------------------------------------------------------------------
+    bool create(GLsizeiptr slotSize, unsigned int slots)
+    {
+        mSlotSize = slotSize;
+        mSlots = slots < MAX_SLOTS ? slots : MAX_SLOTS;
+        mCurrent = mSlots - 1;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, mSlotSize * mSlots, nullptr, flags);
+        mMapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mSlotSize * mSlots, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (mMapped == nullptr)
+        {
+            std::cout << "ERROR::PIXEL_UPLOAD_RING::MAP_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        for (unsigned int i = 0; i < MAX_SLOTS; ++i)
+        {
+            if (mFences[i] != 0)
+                glDeleteSync(mFences[i]);
+            mFences[i] = 0;
+        }
+        if (mBuffer != 0)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+            if (mMapped != nullptr)
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &mBuffer);
+        }
+        mBuffer = 0;
+        mMapped = nullptr;
+    }
+
+    // makes the ring the source of pixel uploads until unbind()
+    // ------------------------------------------------------------------------
+    void bind() const
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+    }
+
+    void unbind() const
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // moves to the next slot, waiting only if the GPU still reads it. Returns
+    // where to write, and in offset the value to pass as the upload's pixels.
+    // ------------------------------------------------------------------------
+    unsigned char* acquire(GLintptr& offset)
+    {
+        mCurrent = (mCurrent + 1) % mSlots;
+        GLsync& fence = mFences[mCurrent];
+        if (fence != 0)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            GLbitfield waitFlags = 0;
+            while (glClientWaitSync(fence, waitFlags, 1000000) == GL_TIMEOUT_EXPIRED)
+                waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            glDeleteSync(fence);
+            fence = 0;
+            mWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        offset = mCurrent * mSlotSize;
+        return mMapped + offset;
+    }
+
+    // fences the current slot once the upload reading it has been issued
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        mFences[mCurrent] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLsizeiptr slotSize() const { return mSlotSize; }
+
+    // total time acquire() spent waiting for slots, reset by the caller
+    double waitMs() const { return mWaitMs; }
+    void resetWaitMs() { mWaitMs = 0.0; }
+
+private:
+    GLuint mBuffer;
+    unsigned char* mMapped;
+    GLsizeiptr mSlotSize;
+    unsigned int mSlots;
+    unsigned int mCurrent;
+    double mWaitMs;
+    GLsync mFences[MAX_SLOTS];
+};
+#endif
@@ -0,0 +1,20 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+// running totals of the GL state changes and draw calls issued by the
+// renderer's building blocks; diff two snapshots to get the cost of a frame
+struct RenderStats
+{
+    unsigned int drawCalls = 0;
+    unsigned int programBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int vertexArrayBinds = 0;
+    unsigned int bufferBinds = 0;
+};
+
+inline RenderStats& renderStats()
+{
+    static RenderStats stats;
+    return stats;
+}
+#endif
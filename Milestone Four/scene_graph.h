@@ -0,0 +1,205 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_GRAPH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace scene_graph_detail
+{
+    // translation * rotation * scale without its last row, which is always
+    // (0, 0, 0, 1): four columns of three, the translation last
+    struct LocalMatrix
+    {
+        float columns[4][3];
+    };
+
+    inline void compose(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, LocalMatrix& out)
+    {
+        const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+        float (&m)[4][3] = out.columns;
+        m[0][0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+        m[0][1] = 2.0f * (xy + wz) * s.x;
+        m[0][2] = 2.0f * (xz - wy) * s.x;
+        m[1][0] = 2.0f * (xy - wz) * s.y;
+        m[1][1] = (1.0f - 2.0f * (xx + zz)) * s.y;
+        m[1][2] = 2.0f * (yz + wx) * s.y;
+        m[2][0] = 2.0f * (xz + wy) * s.z;
+        m[2][1] = 2.0f * (yz - wx) * s.z;
+        m[2][2] = (1.0f - 2.0f * (xx + yy)) * s.z;
+        m[3][0] = t.x;
+        m[3][1] = t.y;
+        m[3][2] = t.z;
+    }
+
+    // out = parent * local, for a parent whose last row is (0, 0, 0, 1) too.
+    // parent and out are column major 4x4, the way glm stores them.
+    inline void transform(const float* parent, const LocalMatrix& local, float* out)
+    {
+        const float (&m)[4][3] = local.columns;
+#ifdef SCENE_GRAPH_SSE2
+        const __m128 p0 = _mm_loadu_ps(parent), p1 = _mm_loadu_ps(parent + 4);
+        const __m128 p2 = _mm_loadu_ps(parent + 8), p3 = _mm_loadu_ps(parent + 12);
+        for (int column = 0; column < 4; ++column)
+        {
+            __m128 result = _mm_mul_ps(p0, _mm_set1_ps(m[column][0]));
+            result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_set1_ps(m[column][1])));
+            result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_set1_ps(m[column][2])));
+            if (column == 3)
+                result = _mm_add_ps(result, p3);
+            _mm_storeu_ps(out + column * 4, result);
+        }
+#else
+        for (int column = 0; column < 4; ++column)
+        {
+            for (int row = 0; row < 4; ++row)
+            {
+                out[column * 4 + row] = parent[row] * m[column][0] + parent[4 + row] * m[column][1]
+                    + parent[8 + row] * m[column][2] + (column == 3 ? parent[12 + row] : 0.0f);
+            }
+        }
+#endif
+    }
+}
+
+// Transform hierarchy stored as parallel arrays, one entry per node: parent
+// index, local translation, rotation and scale, and the world matrix they
+// give, with the local matrix kept composed between changes. A node can only
+// be added under a node that already exists, so parents always precede their
+// children and update() resolves every world matrix in one front to back
+// pass, reading each parent's matrix after it is already final. Only nodes
+// whose local transform changed, and their descendants, are recomputed.
+class SceneGraph
+{
+public:
+    static const int NO_PARENT = -1;
+
+    SceneGraph() : mDirtyCount(0)
+    {
+    }
+
+    // room for count nodes without reallocating
+    // ------------------------------------------------------------------------
+    void reserve(size_t count)
+    {
+        mParent.reserve(count);
+        mTranslation.reserve(count);
+        mRotation.reserve(count);
+        mScale.reserve(count);
+        mLocal.reserve(count);
+        mWorld.reserve(count);
+        mDirty.reserve(count);
+    }
+
+    // appends a node under parent (NO_PARENT for a root) and returns its
+    // index, or NO_PARENT if parent does not exist yet
+    // ------------------------------------------------------------------------
+    int addNode(int parent, const glm::vec3& translation = glm::vec3(0.0f),
+        const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f))
+    {
+        if (parent < NO_PARENT || parent >= (int)mParent.size())
+            return NO_PARENT;
+        mParent.push_back(parent);
+        mTranslation.push_back(translation);
+        mRotation.push_back(rotation);
+        mScale.push_back(scale);
+        mLocal.push_back(scene_graph_detail::LocalMatrix());
+        mWorld.push_back(glm::mat4(1.0f));
+        mDirty.push_back(0);
+        const int node = (int)mParent.size() - 1;
+        markDirty(node);
+        return node;
+    }
+
+    // ------------------------------------------------------------------------
+    void setTranslation(int node, const glm::vec3& translation)
+    {
+        mTranslation[node] = translation;
+        markDirty(node);
+    }
+
+    void setRotation(int node, const glm::quat& rotation)
+    {
+        mRotation[node] = rotation;
+        markDirty(node);
+    }
+
+    void setScale(int node, const glm::vec3& scale)
+    {
+        mScale[node] = scale;
+        markDirty(node);
+    }
+
+    // recomputes the world matrix of every changed node and of everything
+    // under it, a matrix product each; returns how many were recomputed and,
+    // given changed, appends their indices to it in ascending order
+    // ------------------------------------------------------------------------
+    size_t update(std::vector<int>* changed = nullptr)
+    {
+        if (mDirtyCount == 0)
+            return 0;
+        static const float IDENTITY[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        const size_t count = mParent.size();
+        const int* parents = mParent.data();
+        unsigned char* dirty = mDirty.data();
+        glm::mat4* world = mWorld.data();
+        size_t updated = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int parent = parents[i];
+            // a parent earlier in this pass has already passed its flag on
+            if (parent != NO_PARENT)
+                dirty[i] |= dirty[parent];
+            if (!dirty[i])
+                continue;
+            const float* parentWorld = parent == NO_PARENT ? IDENTITY : &world[parent][0][0];
+            scene_graph_detail::transform(parentWorld, mLocal[i], &world[i][0][0]);
+            if (changed)
+                changed->push_back((int)i);
+            ++updated;
+        }
+        memset(dirty, 0, count);
+        mDirtyCount = 0;
+        return updated;
+    }
+
+    // ------------------------------------------------------------------------
+    const glm::mat4& world(int node) const { return mWorld[node]; }
+    int parent(int node) const { return mParent[node]; }
+    size_t size() const { return mParent.size(); }
+
+    // bytes the arrays hold per node
+    static size_t nodeBytes()
+    {
+        return sizeof(int) + 2 * sizeof(glm::vec3) + sizeof(glm::quat) + sizeof(scene_graph_detail::LocalMatrix)
+            + sizeof(glm::mat4) + 1;
+    }
+
+private:
+    // recomposes the node's local matrix; its world matrix waits for update()
+    void markDirty(int node)
+    {
+        scene_graph_detail::compose(mTranslation[node], mRotation[node], mScale[node], mLocal[node]);
+        mDirtyCount += mDirty[node] ? 0 : 1;
+        mDirty[node] = 1;
+    }
+
+    std::vector<int> mParent;               // NO_PARENT or an earlier node
+    std::vector<glm::vec3> mTranslation;
+    std::vector<glm::quat> mRotation;
+    std::vector<glm::vec3> mScale;
+    std::vector<scene_graph_detail::LocalMatrix> mLocal;
+    std::vector<glm::mat4> mWorld;
+    std::vector<unsigned char> mDirty;      // local transform changed since update()
+    size_t mDirtyCount;
+};
+#endif
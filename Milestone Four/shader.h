@@ -5,163 +5,404 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <render_stats.h>
+
+// running totals of the expensive work done by Shader, so the render loop can
+// verify that it never reads shader files or invokes the GLSL compiler
+struct ShaderStats
+{
+    unsigned int fileOpens = 0;
+    unsigned int compiles = 0;
+    unsigned int links = 0;
+};
+
+inline ShaderStats& shaderStats()
+{
+    static ShaderStats stats;
+    return stats;
+}
+
+// uniform upload overloads used by UniformHandle, one per supported C++ type
+inline void uploadUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void uploadUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void uploadUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void uploadUniform(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void uploadUniform(GLint location, const glm::mat2& mat) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void uploadUniform(GLint location, const glm::mat3& mat) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void uploadUniform(GLint location, const glm::mat4& mat) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
+// whether a reflected GL uniform type can be written through a handle of the given C++ type
+inline bool uniformTypeMatches(GLenum type, const bool*) { return type == GL_BOOL; }
+inline bool uniformTypeMatches(GLenum type, const float*) { return type == GL_FLOAT; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec2*) { return type == GL_FLOAT_VEC2; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec3*) { return type == GL_FLOAT_VEC3; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec4*) { return type == GL_FLOAT_VEC4; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat2*) { return type == GL_FLOAT_MAT2; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat3*) { return type == GL_FLOAT_MAT3; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat4*) { return type == GL_FLOAT_MAT4; }
+inline bool uniformTypeMatches(GLenum type, const int*)
+{
+    // samplers are set through their texture unit index
+    switch (type)
+    {
+    case GL_INT:
+    case GL_BOOL:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_CUBE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// A uniform location resolved once through Shader::uniform<T>(). Setting it is a
+// single glUniform call with no string hashing or driver lookup. An unresolved
+// handle has location -1, which GL silently ignores like any inactive uniform.
+template <typename T>
+struct UniformHandle
+{
+    GLint location = -1;
+
+    bool valid() const
+    {
+        return location >= 0;
+    }
+    void set(const T& value) const
+    {
+        uploadUniform(location, value);
+    }
+};
 
 class Shader
 {
 public:
     unsigned int ID;
+    // empty shader, call compile() before use
+    // ------------------------------------------------------------------------
+    Shader() : ID(0), mUniformCount(0)
+    {
+    }
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) : ID(0), mUniformCount(0)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
+        readFile(vertexPath, vertexCode);
+        readFile(fragmentPath, fragmentCode);
+        // if geometry shader path is present, also load a geometry shader
+        if (geometryPath != nullptr)
+            readFile(geometryPath, geometryCode);
+        // 2. compile shaders
+        compile(vertexCode.c_str(), fragmentCode.c_str(), geometryPath != nullptr ? geometryCode.c_str() : nullptr);
+    }
+    // reads a whole shader source file, returns false if it could not be read
+    // ------------------------------------------------------------------------
+    static bool readFile(const char* path, std::string& code)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            ++shaderStats().fileOpens;
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            code = shaderStream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        return true;
+    }
+    // compiles and links the given sources into ID, returns false if a
+    // shader failed to compile or the program failed to link
+    // ------------------------------------------------------------------------
+    bool compile(const char* vShaderCode, const char* fShaderCode, const char* gShaderCode = nullptr)
+    {
+        bool success = true;
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        success &= checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        success &= checkCompileErrors(fragment, "FRAGMENT");
+        shaderStats().compiles += 2;
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
+        unsigned int geometry = 0;
+        if (gShaderCode != nullptr)
         {
-            const char* gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            success &= checkCompileErrors(geometry, "GEOMETRY");
+            ++shaderStats().compiles;
         }
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
+        if (gShaderCode != nullptr)
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        success &= checkCompileErrors(ID, "PROGRAM");
+        ++shaderStats().links;
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if (geometryPath != nullptr)
+        if (gShaderCode != nullptr)
             glDeleteShader(geometry);
-
+        // 3. cache every active uniform location so setters never ask the driver
+        if (success)
+            reflectUniforms();
+        return success;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
         glUseProgram(ID);
+        ++renderStats().programBinds;
+    }
+    // location of an active uniform from the table built at link time, -1 if inactive
+    // ------------------------------------------------------------------------
+    GLint uniformLocation(const char* name) const
+    {
+        const UniformSlot* slot = findUniform(name);
+        return slot != nullptr ? slot->location : -1;
+    }
+    // resolves a typed handle, warns if the uniform is inactive or of a different type
+    // ------------------------------------------------------------------------
+    template <typename T>
+    UniformHandle<T> uniform(const char* name) const
+    {
+        UniformHandle<T> handle;
+        const UniformSlot* slot = findUniform(name);
+        if (slot == nullptr)
+            std::cout << "WARNING::SHADER::UNIFORM_NOT_ACTIVE: " << name << std::endl;
+        else if (!uniformTypeMatches(slot->type, static_cast<const T*>(nullptr)))
+            std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        else
+            handle.location = slot->location;
+        return handle;
+    }
+    // assigns a uniform block to a binding point, returns false if the block is not active
+    // ------------------------------------------------------------------------
+    bool bindUniformBlock(const char* name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
+    // number of uniform names held in the location table
+    // ------------------------------------------------------------------------
+    unsigned int uniformCount() const
+    {
+        return mUniformCount;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(uniformLocation(name.c_str()), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(uniformLocation(name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(uniformLocation(name.c_str()), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(uniformLocation(name.c_str()), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(uniformLocation(name.c_str()), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(uniformLocation(name.c_str()), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(uniformLocation(name.c_str()), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(uniformLocation(name.c_str()), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(uniformLocation(name.c_str()), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    // one open-addressed slot of the uniform table; names live in mUniformNames
+    struct UniformSlot
+    {
+        uint32_t hash = 0;
+        uint32_t nameOffset = 0;
+        GLint location = -1;
+        GLenum type = 0;
+    };
+
+    std::vector<UniformSlot> mUniformSlots;  // power-of-two sized, empty slots have location -1
+    std::string mUniformNames;               // NUL separated uniform names
+    unsigned int mUniformCount;
+
+    // 32-bit FNV-1a of a NUL terminated name
+    // ------------------------------------------------------------------------
+    static uint32_t hashName(const char* name)
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name != '\0'; ++name)
+        {
+            hash ^= (unsigned char)*name;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+    // ------------------------------------------------------------------------
+    const UniformSlot* findUniform(const char* name) const
+    {
+        if (mUniformSlots.empty())
+            return nullptr;
+        uint32_t hash = hashName(name);
+        size_t mask = mUniformSlots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
+        {
+            const UniformSlot& slot = mUniformSlots[i];
+            if (slot.location < 0)
+                return nullptr;
+            if (slot.hash == hash && std::strcmp(mUniformNames.c_str() + slot.nameOffset, name) == 0)
+                return &slot;
+        }
+    }
+    // ------------------------------------------------------------------------
+    void insertUniform(const char* name, GLint location, GLenum type)
+    {
+        if (location < 0 || findUniform(name) != nullptr)
+            return;
+        UniformSlot slot;
+        slot.hash = hashName(name);
+        slot.nameOffset = (uint32_t)mUniformNames.size();
+        slot.location = location;
+        slot.type = type;
+        mUniformNames.append(name);
+        mUniformNames.push_back('\0');
+
+        size_t mask = mUniformSlots.size() - 1;
+        size_t i = slot.hash & mask;
+        while (mUniformSlots[i].location >= 0)
+            i = (i + 1) & mask;
+        mUniformSlots[i] = slot;
+        ++mUniformCount;
+    }
+
+    // queries GL_ACTIVE_UNIFORMS once and fills the location table. Arrays are
+    // registered under their base name and under every element name.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        struct Active
+        {
+            std::string name;
+            GLint size;
+            GLenum type;
+        };
+        std::vector<Active> active;
+        size_t names = 0;
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            Active uniform;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &uniform.size, &uniform.type, buffer.data());
+            uniform.name.assign(buffer.data(), length);
+            names += uniform.size + 1;
+            active.push_back(uniform);
+        }
+
+        // keep the table at most half full so probe sequences stay short
+        size_t capacity = 8;
+        while (capacity < names * 2)
+            capacity *= 2;
+        mUniformSlots.assign(capacity, UniformSlot());
+        mUniformNames.clear();
+        mUniformCount = 0;
+
+        for (const Active& uniform : active)
+        {
+            // uniforms inside a uniform block have no location and are skipped
+            GLint location = glGetUniformLocation(ID, uniform.name.c_str());
+            insertUniform(uniform.name.c_str(), location, uniform.type);
+            // only a trailing "[0]" names an array; "lights[0].position" is a
+            // member of one struct element and keeps its full name
+            const size_t length = uniform.name.size();
+            const bool firstElement = length > 3 && uniform.name.compare(length - 3, 3, "[0]") == 0;
+            if (uniform.size > 1 || firstElement)
+            {
+                std::string base = firstElement ? uniform.name.substr(0, length - 3) : uniform.name;
+                insertUniform(base.c_str(), location, uniform.type);
+                for (GLint element = 1; element < uniform.size; ++element)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    insertUniform(elementName.c_str(), glGetUniformLocation(ID, elementName.c_str()), uniform.type);
+                }
+            }
+        }
+    }
+    // utility function for checking shader compilation/linking errors, false on failure.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -183,6 +424,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <shader.h>
+
+// Owns every shader program used by the scene. Programs are compiled once at
+// startup and live until the cache is destroyed, so the render loop only ever
+// binds an existing program. Entries are keyed by the source paths plus a hash
+// of the file contents, so an edited shader gets a fresh program instead of
+// silently reusing a stale one.
+class ShaderCache
+{
+public:
+    ShaderCache() = default;
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    ~ShaderCache()
+    {
+        clear();
+    }
+
+    // returns the program built from the given files, compiling it on first request.
+    // Returns nullptr if a source file could not be read or the program failed to
+    // compile or link; a failed program is not cached, so the next call retries it.
+    // ------------------------------------------------------------------------
+    Shader* load(const char* vertexPath, const char* fragmentPath)
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+        if (!Shader::readFile(vertexPath, vertexCode) || !Shader::readFile(fragmentPath, fragmentCode))
+            return nullptr;
+
+        // hash the sources together so a change to either file invalidates the entry
+        uint64_t hash = hashBytes(vertexCode.data(), vertexCode.size());
+        hash = hashBytes(fragmentCode.data(), fragmentCode.size(), hash);
+
+        for (const std::unique_ptr<Entry>& entry : mEntries)
+        {
+            if (entry->hash == hash && entry->vertexPath == vertexPath && entry->fragmentPath == fragmentPath)
+                return &entry->shader;
+        }
+
+        std::unique_ptr<Entry> entry(new Entry());
+        entry->vertexPath = vertexPath;
+        entry->fragmentPath = fragmentPath;
+        entry->hash = hash;
+        if (!entry->shader.compile(vertexCode.c_str(), fragmentCode.c_str()))
+        {
+            glDeleteProgram(entry->shader.ID);
+            return nullptr;
+        }
+        mEntries.push_back(std::move(entry));
+        return &mEntries.back()->shader;
+    }
+
+    // deletes every program owned by the cache
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        for (const std::unique_ptr<Entry>& entry : mEntries)
+            glDeleteProgram(entry->shader.ID);
+        mEntries.clear();
+    }
+
+    size_t size() const
+    {
+        return mEntries.size();
+    }
+
+    // 64-bit FNV-1a, chained through seed so several buffers can share one hash
+    // ------------------------------------------------------------------------
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+private:
+    struct Entry
+    {
+        std::string vertexPath;
+        std::string fragmentPath;
+        uint64_t hash = 0;
+        Shader shader;
+    };
+
+    // entries are heap allocated so the Shader pointers handed out stay valid as the cache grows
+    std::vector<std::unique_ptr<Entry>> mEntries;
+};
+#endif
@@ -0,0 +1,225 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+#include <baked_texture.h>
+
+// 64-bit hash of a byte range, 8 bytes per step. Not cryptographic, but any
+// change to the bytes changes it with overwhelming probability. Unlike the
+// byte-at-a-time FNV-1a ShaderCache uses for small shader sources, this has
+// to keep up with multi-MB texture sources on every startup.
+// ----------------------------------------------------------------------------
+inline uint64_t textureContentHash(const void* data, size_t size, uint64_t seed = 0)
+{
+    const uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed ^ (size * PRIME);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * PRIME;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    hash = (hash ^ tail) * PRIME;
+
+    // final avalanche, so every input bit reaches every output bit
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Decoded textures kept between runs: a directory of baked texture files
+// named after a key, the hash of the source image's bytes and of every
+// option that shaped the pixels, which each entry also carries as its
+// header's contentKey. A source that changes, or different load options,
+// give a new key and a new entry; the one they replace is never looked up
+// again. So the directory stays bounded, every store() drops the least
+// recently used entries, by modification time, until the rest fit in the
+// size given to open(); lookup() refreshes the time of the entry it maps.
+// Entries are mapped, not read, when they are used.
+class TextureCache
+{
+public:
+    TextureCache() : mMaxBytes(0)
+    {
+    }
+
+    // uses directory, creating it if needed, and keeps it under maxBytes (0
+    // for no limit); false if it cannot be created
+    // ------------------------------------------------------------------------
+    bool open(const char* directory, uint64_t maxBytes)
+    {
+        mDirectory = directory;
+        mMaxBytes = maxBytes;
+#ifdef _WIN32
+        _mkdir(directory);
+#else
+        mkdir(directory, 0755);
+#endif
+        struct stat info;
+        if (stat(directory, &info) != 0 || (info.st_mode & S_IFDIR) == 0)
+            mDirectory.clear();
+        return enabled();
+    }
+
+    // stops using the directory; the entries stay on disk
+    void close() { mDirectory.clear(); }
+
+    bool enabled() const { return !mDirectory.empty(); }
+
+    // ------------------------------------------------------------------------
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.mtex", (unsigned long long)key);
+        return mDirectory + name;
+    }
+
+    // maps the entry for key, false if there is none or it is not valid
+    // ------------------------------------------------------------------------
+    bool lookup(uint64_t key, BakedTexture& texture) const
+    {
+        const std::string entry = path(key);
+        if (!enabled() || !texture.open(entry.c_str()) || texture.header().contentKey != key)
+            return false;
+        // the entry was just used, so it is the last to be dropped
+#ifdef _WIN32
+        _utime(entry.c_str(), nullptr);
+#else
+        utime(entry.c_str(), nullptr);
+#endif
+        return true;
+    }
+
+    // writes the entry for key, then drops the oldest entries past the size
+    // limit; a temporary file renamed into place keeps other runs from
+    // mapping a half written entry
+    // ------------------------------------------------------------------------
+    bool store(uint64_t key, BakedTextureHeader header, const std::vector<std::vector<unsigned char> >& levels) const
+    {
+        if (!enabled())
+            return false;
+        header.contentKey = key;
+        const std::string target = path(key);
+        const std::string temporary = target + ".tmp";
+        if (!writeBakedTexture(temporary.c_str(), header, levels))
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        // rename does not replace an existing file on Windows
+        std::remove(target.c_str());
+        if (std::rename(temporary.c_str(), target.c_str()) != 0)
+            return false;
+        prune(target);
+        return true;
+    }
+
+    // deletes every entry in the directory, whatever run wrote it; returns
+    // how many were deleted
+    // ------------------------------------------------------------------------
+    size_t clear() const
+    {
+        std::vector<Entry> entries;
+        list(entries);
+        size_t removed = 0;
+        for (const Entry& entry : entries)
+            removed += std::remove(entry.path.c_str()) == 0 ? 1 : 0;
+        return removed;
+    }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        uint64_t size;
+        time_t time;
+    };
+
+    // every *.mtex file in the directory
+    void list(std::vector<Entry>& entries) const
+    {
+        if (!enabled())
+            return;
+#ifdef _WIN32
+        _finddata64_t found;
+        const intptr_t handle = _findfirst64((mDirectory + "/*.mtex").c_str(), &found);
+        if (handle == -1)
+            return;
+        do
+        {
+            Entry entry = { mDirectory + "/" + found.name, (uint64_t)found.size, (time_t)found.time_write };
+            entries.push_back(entry);
+        } while (_findnext64(handle, &found) == 0);
+        _findclose(handle);
+#else
+        DIR* directory = opendir(mDirectory.c_str());
+        if (directory == nullptr)
+            return;
+        while (const dirent* file = readdir(directory))
+        {
+            const size_t length = strlen(file->d_name);
+            struct stat info;
+            Entry entry = { mDirectory + "/" + file->d_name, 0, 0 };
+            if (length <= 5 || strcmp(file->d_name + length - 5, ".mtex") != 0 || stat(entry.path.c_str(), &info) != 0)
+                continue;
+            entry.size = (uint64_t)info.st_size;
+            entry.time = info.st_mtime;
+            entries.push_back(entry);
+        }
+        closedir(directory);
+#endif
+    }
+
+    // deletes the oldest entries until the directory fits in mMaxBytes;
+    // keep, the entry just written, stays even if it alone is larger.
+    // Loader threads prune concurrently: an entry another one already
+    // deleted just fails to be deleted again.
+    void prune(const std::string& keep) const
+    {
+        if (mMaxBytes == 0)
+            return;
+        std::vector<Entry> entries;
+        list(entries);
+        uint64_t total = 0;
+        for (const Entry& entry : entries)
+            total += entry.size;
+        if (total <= mMaxBytes)
+            return;
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        for (size_t i = 0; i < entries.size() && total > mMaxBytes; ++i)
+        {
+            if (entries[i].path == keep)
+                continue;
+            std::remove(entries[i].path.c_str());
+            total -= entries[i].size;
+        }
+    }
+
+    std::string mDirectory;
+    uint64_t mMaxBytes;
+};
+#endif
@@ -0,0 +1,192 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#include <image_io.h>
+#include <mapped_file.h>
+
+// One image decoded by the TextureLoader, handed to the GL thread for upload
+struct DecodedImage
+{
+    int index = -1;                     // position of the file in the list given to start()
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* pixels = nullptr;    // null when decoding failed
+    const char* error = nullptr;        // and why
+    // whole mip chain in its upload format, if a prepare step built one
+    std::vector<std::vector<unsigned char> > levels;
+
+    DecodedImage() = default;
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+    DecodedImage(DecodedImage&& other) { *this = std::move(other); }
+    DecodedImage& operator=(DecodedImage&& other)
+    {
+        release();
+        index = other.index;
+        path = std::move(other.path);
+        width = other.width;
+        height = other.height;
+        channels = other.channels;
+        error = other.error;
+        levels = std::move(other.levels);
+        mStorage = std::move(other.mStorage);
+        mOwnedByStb = other.mOwnedByStb;
+        pixels = mOwnedByStb ? other.pixels : mStorage.data();
+        other.pixels = nullptr;
+        other.mOwnedByStb = false;
+        return *this;
+    }
+    ~DecodedImage() { release(); }
+
+    // swaps the pixels for a processed copy, e.g. after resampling
+    void replace(std::vector<unsigned char>&& data, int newWidth, int newHeight)
+    {
+        release();
+        mStorage = std::move(data);
+        pixels = mStorage.data();
+        width = newWidth;
+        height = newHeight;
+    }
+
+private:
+    friend class TextureLoader;
+
+    void release()
+    {
+        if (mOwnedByStb && pixels != nullptr)
+            freeImage(pixels);
+        mOwnedByStb = false;
+        pixels = nullptr;
+        std::vector<unsigned char>().swap(mStorage);
+        levels.clear();
+    }
+
+    std::vector<unsigned char> mStorage;
+    bool mOwnedByStb = false;
+};
+
+// Decodes a list of image files on a pool of worker threads. Each worker maps
+// a file, decodes it straight from the mapping with decodeImage(), unmaps it
+// and runs an optional prepare step (flipping, resampling) before queueing
+// the result, so the GL thread only uploads. Images come out of next() in completion order.
+// stb_image keeps its failure reason in a global, so concurrent failures may
+// report each other's reason; decoding itself is thread-safe.
+class TextureLoader
+{
+public:
+    typedef std::function<void(DecodedImage&)> PrepareFunction;
+
+    TextureLoader() : mNext(0), mDelivered(0)
+    {
+    }
+
+    ~TextureLoader()
+    {
+        join();
+    }
+
+    // starts decoding every file on up to threads workers (0: one per core)
+    // ------------------------------------------------------------------------
+    void start(const char* const* paths, int count, PrepareFunction prepare = PrepareFunction(), unsigned int threads = 0)
+    {
+        join();
+        mPaths.assign(paths, paths + count);
+        mPrepare = prepare;
+        mNext = 0;
+        mDelivered = 0;
+        mDone.clear();
+
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        if (threads > (unsigned int)count)
+            threads = (unsigned int)count;
+        for (unsigned int i = 0; i < threads; ++i)
+            mWorkers.emplace_back(&TextureLoader::work, this);
+    }
+
+    // waits for the next decoded image; false once every image was delivered
+    // ------------------------------------------------------------------------
+    bool next(DecodedImage& image)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mDelivered == mPaths.size())
+            return false;
+        mReady.wait(lock, [this] { return !mDone.empty(); });
+        image = std::move(mDone.front());
+        mDone.pop_front();
+        ++mDelivered;
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void join()
+    {
+        for (std::thread& worker : mWorkers)
+            worker.join();
+        mWorkers.clear();
+    }
+
+private:
+    void work()
+    {
+        for (;;)
+        {
+            size_t index = mNext++;
+            if (index >= mPaths.size())
+                return;
+
+            DecodedImage image;
+            image.index = (int)index;
+            image.path = mPaths[index];
+
+            // no copy of the file: the decoder reads the page cache directly
+            MappedFile file;
+            if (file.open(mPaths[index].c_str()))
+            {
+                file.adviseSequential();
+                ImageInfo info;
+                image.pixels = decodeImage(file.data(), file.size(), info);
+                image.width = info.width;
+                image.height = info.height;
+                image.channels = info.channels;
+                image.error = info.error;
+                image.mOwnedByStb = image.pixels != nullptr;
+            }
+            else
+            {
+                image.error = "cannot read the file";
+            }
+            file.close();
+
+            if (image.pixels != nullptr && mPrepare)
+                mPrepare(image);
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDone.push_back(std::move(image));
+            mReady.notify_one();
+        }
+    }
+
+    std::vector<std::string> mPaths;
+    PrepareFunction mPrepare;
+    std::vector<std::thread> mWorkers;
+    std::atomic<size_t> mNext;          // next file to hand to a worker
+    size_t mDelivered;                  // images returned by next()
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::deque<DecodedImage> mDone;     // decoded, waiting for the GL thread
+};
+#endif
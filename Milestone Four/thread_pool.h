@@ -0,0 +1,146 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+// A fixed set of worker threads that run parallel loops. Any thread may call
+// parallelFor(), several at once; the caller works on its own loop too, so a
+// loop started from inside another one (or from the texture loader's
+// threads) always finishes even when every worker is busy.
+class ThreadPool
+{
+public:
+    // threads extra workers; 0 starts one per core besides the caller
+    // ------------------------------------------------------------------------
+    explicit ThreadPool(unsigned int threads = 0) : mStop(false)
+    {
+        if (threads == 0)
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            threads = cores > 1 ? cores - 1 : 0;
+        }
+        for (unsigned int i = 0; i < threads; ++i)
+            mWorkers.emplace_back(&ThreadPool::work, this);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        for (std::thread& worker : mWorkers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // calls body(begin, end) over [0, count) in ranges of at most grain
+    // indices, in any order, and returns once every range is done
+    // ------------------------------------------------------------------------
+    void parallelFor(int count, const std::function<void(int, int)>& body, int grain = 1)
+    {
+        if (count <= 0)
+            return;
+        Loop loop(count, grain > 0 ? grain : 1, body);
+        if (!mWorkers.empty() && count > loop.grain)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mLoops.push_back(&loop);
+        }
+        mWake.notify_all();
+        runRanges(loop);
+
+        // the loop lives on this stack: wait until no worker can touch it
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [&]() { return loop.remaining == 0 && loop.active == 0; });
+        for (std::deque<Loop*>::iterator it = mLoops.begin(); it != mLoops.end(); ++it)
+        {
+            if (*it == &loop)
+            {
+                mLoops.erase(it);
+                break;
+            }
+        }
+    }
+
+    // threads a loop can run on at once, the caller included
+    unsigned int concurrency() const { return (unsigned int)mWorkers.size() + 1; }
+
+private:
+    struct Loop
+    {
+        Loop(int count, int grain, const std::function<void(int, int)>& body)
+            : count(count), grain(grain), body(body), next(0), remaining(count), active(0)
+        {
+        }
+
+        const int count;
+        const int grain;
+        const std::function<void(int, int)>& body;
+        std::atomic<int> next;          // first index nobody has taken yet
+        std::atomic<int> remaining;     // indices not finished yet
+        int active;                     // workers inside the loop, guarded by mMutex
+    };
+
+    // takes ranges of loop until none are left
+    // ------------------------------------------------------------------------
+    void runRanges(Loop& loop)
+    {
+        for (int begin = loop.next.fetch_add(loop.grain); begin < loop.count; begin = loop.next.fetch_add(loop.grain))
+        {
+            int end = begin + loop.grain < loop.count ? begin + loop.grain : loop.count;
+            loop.body(begin, end);
+            if (loop.remaining.fetch_sub(end - begin) == end - begin)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mDone.notify_all();
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (;;)
+        {
+            mWake.wait(lock, [&]() { return mStop || !mLoops.empty(); });
+            if (mStop)
+                return;
+            Loop* loop = mLoops.front();
+            ++loop->active;
+            lock.unlock();
+            runRanges(*loop);
+            lock.lock();
+            // every range is taken, let the workers move on to the next loop
+            if (!mLoops.empty() && mLoops.front() == loop)
+                mLoops.pop_front();
+            --loop->active;
+            mDone.notify_all();
+        }
+    }
+
+    std::vector<std::thread> mWorkers;
+    std::deque<Loop*> mLoops;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    bool mStop;
+};
+
+// The pool shared by everything that splits work across cores
+inline ThreadPool& sharedThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+#endif
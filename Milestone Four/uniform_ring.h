@@ -0,0 +1,129 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <iostream>
+#include <cstring>
+
+#include <render_stats.h>
+
+// A persistently mapped uniform buffer split into one region per frame in
+// flight. Each frame the CPU writes its uniform blocks into the next region
+// while the GPU may still be reading the previous ones; a fence per region
+// makes sure a region is never overwritten before the GPU is done with it.
+// Requires GL 4.4 (or ARB_buffer_storage).
+class UniformRing
+{
+public:
+    static const unsigned int MAX_FRAMES = 3;
+
+    UniformRing() : mBuffer(0), mMapped(nullptr), mAlignment(256), mFrameSize(0), mFrames(0), mCurrent(0), mUsed(0)
+    {
+        for (unsigned int i = 0; i < MAX_FRAMES; ++i)
+            mFences[i] = 0;
+    }
+
+    // allocates frames regions of at least frameSize bytes each
+    // ------------------------------------------------------------------------
+    bool create(GLsizeiptr frameSize, unsigned int frames = MAX_FRAMES)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment > 0)
+            mAlignment = alignment;
+        mFrameSize = align(frameSize);
+        mFrames = frames < MAX_FRAMES ? frames : MAX_FRAMES;
+        mCurrent = mFrames - 1;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, mFrameSize * mFrames, nullptr, flags);
+        mMapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, mFrameSize * mFrames, flags));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        if (mMapped == nullptr)
+        {
+            std::cout << "ERROR::UNIFORM_RING::MAP_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        for (unsigned int i = 0; i < MAX_FRAMES; ++i)
+        {
+            if (mFences[i] != 0)
+                glDeleteSync(mFences[i]);
+            mFences[i] = 0;
+        }
+        if (mBuffer != 0)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+            if (mMapped != nullptr)
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glDeleteBuffers(1, &mBuffer);
+        }
+        mBuffer = 0;
+        mMapped = nullptr;
+    }
+
+    // moves to the next region, waiting only if the GPU still reads it
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        mCurrent = (mCurrent + 1) % mFrames;
+        mUsed = 0;
+        GLsync& fence = mFences[mCurrent];
+        if (fence != 0)
+        {
+            GLbitfield waitFlags = 0;
+            while (glClientWaitSync(fence, waitFlags, 1000000) == GL_TIMEOUT_EXPIRED)
+                waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // copies one uniform block into the current region and binds it to the given binding point
+    // ------------------------------------------------------------------------
+    void write(GLuint binding, const void* data, GLsizeiptr size)
+    {
+        GLintptr offset = mCurrent * mFrameSize + mUsed;
+        if (mUsed + size > mFrameSize)
+        {
+            std::cout << "ERROR::UNIFORM_RING::FRAME_OVERFLOW" << std::endl;
+            return;
+        }
+        memcpy(mMapped + offset, data, size);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, mBuffer, offset, size);
+        ++renderStats().bufferBinds;
+        mUsed += align(size);
+    }
+
+    // fences the current region once every draw reading it has been issued
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        mFences[mCurrent] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLsizeiptr align(GLsizeiptr size) const
+    {
+        return (size + mAlignment - 1) / mAlignment * mAlignment;
+    }
+
+private:
+    GLuint mBuffer;
+    unsigned char* mMapped;
+    GLsizeiptr mAlignment;
+    GLsizeiptr mFrameSize;
+    unsigned int mFrames;
+    unsigned int mCurrent;
+    GLsizeiptr mUsed;
+    GLsync mFences[MAX_FRAMES];
+};
+#endif
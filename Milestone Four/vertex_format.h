@@ -0,0 +1,363 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A vertex as meshes are built on the CPU, every attribute in full floats.
+// A VertexFormat decides which of them reach the GPU and in what encoding.
+struct SourceVertex
+{
+    float position[3];
+    float normal[3];
+    float color[4];
+    float uv[2];
+    float tangent[4];   // xyz along +u, w = +-1: bitangent = w * cross(normal, tangent)
+};
+
+enum VertexAttribute
+{
+    VERTEX_POSITION,
+    VERTEX_NORMAL,
+    VERTEX_COLOR,
+    VERTEX_UV,
+    VERTEX_TANGENT,
+    VERTEX_ATTRIBUTE_COUNT
+};
+
+// How an attribute is stored in the vertex buffer
+enum VertexEncoding
+{
+    VERTEX_UNUSED,      // not stored, the shader does not read it
+    VERTEX_FLOAT,       // GL_FLOAT per component
+    VERTEX_HALF,        // GL_HALF_FLOAT per component, padded to a multiple of two
+    VERTEX_PACKED,      // GL_INT_2_10_10_10_REV, signed normalized, for unit vectors
+    VERTEX_UNORM8       // GL_UNSIGNED_BYTE normalized, for colors in [0, 1]
+};
+
+// float to IEEE half, rounded to nearest even; out of range values become
+// infinity and tiny ones denormals or zero
+// ----------------------------------------------------------------------------
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000)
+        return (uint16_t)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));  // inf, nan
+    if (magnitude >= 0x477FF000)
+        return (uint16_t)(sign | 0x7C00);   // rounds to above 65504
+    if (magnitude < 0x38800000)
+    {
+        // denormal: shift the mantissa, implicit bit included, into place
+        if (magnitude < 0x33000000)
+            return (uint16_t)sign;
+        const uint32_t shift = 126 - (magnitude >> 23);
+        const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+    // normal: rebias the exponent, round the 13 dropped mantissa bits
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    const uint32_t rest = magnitude & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;
+    return (uint16_t)(sign | half);
+}
+
+// x, y, z in [-1, 1] as GL_INT_2_10_10_10_REV, w (-1, 0 or 1) in the top bits
+// ----------------------------------------------------------------------------
+inline uint32_t packSnorm10(const float* v, int w = 0)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        float c = v[i] < -1.0f ? -1.0f : (v[i] > 1.0f ? 1.0f : v[i]);
+        int32_t value = (int32_t)(c * 511.0f + (c < 0.0f ? -0.5f : 0.5f));
+        packed |= ((uint32_t)value & 0x3FF) << (10 * i);
+    }
+    return packed | ((uint32_t)w & 3) << 30;
+}
+
+// Layout of one interleaved vertex: the encoding and shader location of every
+// attribute, and the offsets that follow from them. Every attribute starts on
+// a 4 byte boundary, as GL implementations fetch fastest from aligned data.
+class VertexFormat
+{
+public:
+    // only positions, in floats, until set() adds more. Shader locations
+    // default to those of the lighting shader: position 0, normal 1, uv 2
+    // (3 is the per-draw material); colors get 4 and tangents 5.
+    VertexFormat() : mStride(0)
+    {
+        const GLuint locations[VERTEX_ATTRIBUTE_COUNT] = { 0, 1, 4, 2, 5 };
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        {
+            mEncodings[i] = VERTEX_UNUSED;
+            mLocations[i] = locations[i];
+            mOffsets[i] = 0;
+        }
+        set(VERTEX_POSITION, VERTEX_FLOAT);
+    }
+
+    // the attributes marked in used, all in full floats as meshes were stored before
+    // ------------------------------------------------------------------------
+    static VertexFormat full(const bool (&used)[VERTEX_ATTRIBUTE_COUNT])
+    {
+        VertexFormat format;
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+            format.set((VertexAttribute)i, used[i] ? VERTEX_FLOAT : VERTEX_UNUSED);
+        return format;
+    }
+
+    // half float positions and texture coordinates, packed normals and
+    // tangents, byte colors: 16 bytes for position, normal and texture
+    // coordinates, 20 with tangents
+    // ------------------------------------------------------------------------
+    static VertexFormat compact(const bool (&used)[VERTEX_ATTRIBUTE_COUNT])
+    {
+        const VertexEncoding encodings[VERTEX_ATTRIBUTE_COUNT] = { VERTEX_HALF, VERTEX_PACKED, VERTEX_UNORM8, VERTEX_HALF, VERTEX_PACKED };
+        VertexFormat format;
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+            format.set((VertexAttribute)i, used[i] ? encodings[i] : VERTEX_UNUSED);
+        return format;
+    }
+
+    // ------------------------------------------------------------------------
+    void set(VertexAttribute attribute, VertexEncoding encoding)
+    {
+        mEncodings[attribute] = encoding;
+        mStride = 0;
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        {
+            mOffsets[i] = mStride;
+            mStride += storedSize((VertexAttribute)i);
+        }
+    }
+
+    // shader input the attribute is bound to
+    void setLocation(VertexAttribute attribute, GLuint location) { mLocations[attribute] = location; }
+
+    VertexEncoding encoding(VertexAttribute attribute) const { return mEncodings[attribute]; }
+    GLsizei offset(VertexAttribute attribute) const { return mOffsets[attribute]; }
+    GLsizei stride() const { return mStride; }
+
+    // bytes the attribute takes in every vertex
+    // ------------------------------------------------------------------------
+    GLsizei storedSize(VertexAttribute attribute) const
+    {
+        const GLsizei count = components(attribute);
+        switch (mEncodings[attribute])
+        {
+        case VERTEX_FLOAT: return count * 4;
+        case VERTEX_HALF: return (count + 1) / 2 * 4;
+        case VERTEX_PACKED: return 4;
+        case VERTEX_UNORM8: return (count + 3) / 4 * 4;
+        default: return 0;
+        }
+    }
+
+    // appends count vertices in this format to out
+    // ------------------------------------------------------------------------
+    void pack(const SourceVertex* vertices, size_t count, std::vector<unsigned char>& out) const
+    {
+        size_t start = out.size();
+        out.resize(start + count * mStride, 0);
+        for (size_t v = 0; v < count; ++v)
+        {
+            const float* sources[VERTEX_ATTRIBUTE_COUNT] = {
+                vertices[v].position, vertices[v].normal, vertices[v].color, vertices[v].uv, vertices[v].tangent };
+            unsigned char* vertex = out.data() + start + v * mStride;
+            for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+                packAttribute((VertexAttribute)i, sources[i], vertex + mOffsets[i]);
+        }
+    }
+
+    // describes every stored attribute to the bound VAO, reading from the
+    // bound GL_ARRAY_BUFFER
+    // ------------------------------------------------------------------------
+    void apply() const
+    {
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        {
+            const void* offset = (const void*)(size_t)mOffsets[i];
+            const GLint count = components(i);
+            switch (mEncodings[i])
+            {
+            case VERTEX_FLOAT:
+                glVertexAttribPointer(mLocations[i], count, GL_FLOAT, GL_FALSE, mStride, offset);
+                break;
+            case VERTEX_HALF:
+                glVertexAttribPointer(mLocations[i], count, GL_HALF_FLOAT, GL_FALSE, mStride, offset);
+                break;
+            case VERTEX_PACKED:
+                glVertexAttribPointer(mLocations[i], 4, GL_INT_2_10_10_10_REV, GL_TRUE, mStride, offset);
+                break;
+            case VERTEX_UNORM8:
+                glVertexAttribPointer(mLocations[i], count, GL_UNSIGNED_BYTE, GL_TRUE, mStride, offset);
+                break;
+            default:
+                continue;
+            }
+            glEnableVertexAttribArray(mLocations[i]);
+        }
+    }
+
+    // e.g. "position half, uv half (12 bytes)"
+    // ------------------------------------------------------------------------
+    std::string describe() const
+    {
+        static const char* const ENCODING_NAMES[] = { "unused", "float", "half", "2_10_10_10", "unorm8" };
+        std::string text;
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        {
+            if (mEncodings[i] == VERTEX_UNUSED)
+                continue;
+            if (!text.empty())
+                text += ", ";
+            text += std::string(attributeName(i)) + " " + ENCODING_NAMES[mEncodings[i]];
+        }
+        return text + " (" + std::to_string(mStride) + " bytes)";
+    }
+
+    // Compares the format with the vertex inputs of a linked program. Every
+    // input must be fed by a stored attribute at its location, or by one of
+    // otherLocations (attributes from other buffers, such as the per-draw
+    // material); an integer input fed floats reads garbage. Each problem is
+    // appended to errors, or to warnings if it only costs bandwidth or
+    // components the shader gets defaults for. True if there are no errors.
+    // ------------------------------------------------------------------------
+    bool check(GLuint program, const std::vector<GLuint>& otherLocations,
+        std::vector<std::string>& errors, std::vector<std::string>& warnings) const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        bool read[VERTEX_ATTRIBUTE_COUNT] = {};
+        const size_t errorCount = errors.size();
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            const std::string name(buffer.data(), length);
+            const GLint location = glGetAttribLocation(program, name.c_str());
+            if (location < 0)
+                continue;   // built-in inputs such as gl_VertexID
+
+            int attribute = 0;
+            while (attribute < VERTEX_ATTRIBUTE_COUNT
+                && (mEncodings[attribute] == VERTEX_UNUSED || mLocations[attribute] != (GLuint)location))
+            {
+                ++attribute;
+            }
+            int inputComponents = 0;
+            bool integer = false;
+            inputType(type, inputComponents, integer);
+            const std::string input = name + " (location " + std::to_string(location) + ")";
+            if (attribute == VERTEX_ATTRIBUTE_COUNT)
+            {
+                bool other = false;
+                for (GLuint otherLocation : otherLocations)
+                    other = other || otherLocation == (GLuint)location;
+                if (!other)
+                    errors.push_back(input + " is not fed by any vertex attribute");
+                continue;
+            }
+            read[attribute] = true;
+            if (integer)
+                errors.push_back(input + " is an integer input but " + attributeName(attribute) + " is stored as floats");
+            else if (inputComponents > components(attribute))
+                warnings.push_back(input + " has " + std::to_string(inputComponents) + " components, "
+                    + attributeName(attribute) + " only " + std::to_string(components(attribute)));
+        }
+        for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        {
+            if (mEncodings[i] != VERTEX_UNUSED && !read[i])
+                warnings.push_back(std::string(attributeName(i)) + " is stored at location "
+                    + std::to_string(mLocations[i]) + " but the program does not read it");
+        }
+        return errors.size() == errorCount;
+    }
+
+    // ------------------------------------------------------------------------
+    static const char* attributeName(int attribute)
+    {
+        static const char* const NAMES[VERTEX_ATTRIBUTE_COUNT] = { "position", "normal", "color", "uv", "tangent" };
+        return NAMES[attribute];
+    }
+
+private:
+    // component count and kind of a vertex shader input type
+    static void inputType(GLenum type, int& count, bool& integer)
+    {
+        integer = false;
+        switch (type)
+        {
+        case GL_FLOAT: count = 1; break;
+        case GL_FLOAT_VEC2: count = 2; break;
+        case GL_FLOAT_VEC3: count = 3; break;
+        case GL_FLOAT_VEC4: count = 4; break;
+        case GL_INT: case GL_UNSIGNED_INT: count = 1; integer = true; break;
+        case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: count = 2; integer = true; break;
+        case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: count = 3; integer = true; break;
+        case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: count = 4; integer = true; break;
+        default: count = 4; break;   // matrices and doubles are never stored per vertex here
+        }
+    }
+
+    // components of every attribute in SourceVertex
+    static GLsizei components(int attribute)
+    {
+        static const GLsizei COUNTS[VERTEX_ATTRIBUTE_COUNT] = { 3, 3, 4, 2, 4 };
+        return COUNTS[attribute];
+    }
+
+    void packAttribute(VertexAttribute attribute, const float* source, unsigned char* target) const
+    {
+        const int count = components(attribute);
+        switch (mEncodings[attribute])
+        {
+        case VERTEX_FLOAT:
+            memcpy(target, source, count * sizeof(float));
+            break;
+        case VERTEX_HALF:
+            for (int c = 0; c < count; ++c)
+            {
+                uint16_t half = floatToHalf(source[c]);
+                memcpy(target + c * 2, &half, 2);
+            }
+            break;
+        case VERTEX_PACKED:
+        {
+            uint32_t packed = packSnorm10(source, count == 4 ? (source[3] < 0.0f ? -1 : 1) : 0);
+            memcpy(target, &packed, 4);
+            break;
+        }
+        case VERTEX_UNORM8:
+            for (int c = 0; c < count; ++c)
+            {
+                float value = source[c] < 0.0f ? 0.0f : (source[c] > 1.0f ? 1.0f : source[c]);
+                target[c] = (unsigned char)(value * 255.0f + 0.5f);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    VertexEncoding mEncodings[VERTEX_ATTRIBUTE_COUNT];
+    GLuint mLocations[VERTEX_ATTRIBUTE_COUNT];
+    GLsizei mOffsets[VERTEX_ATTRIBUTE_COUNT];
+    GLsizei mStride;
+};
+#endif
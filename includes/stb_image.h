@@ -510,6 +510,21 @@ extern "C" {
     // flip the image vertically, so the first pixel in the output array is the bottom left
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+    // hand independent rows of work to a thread pool. The JPEG decoder runs the
+    // dequantize/IDCT of progressive images and the color conversion of every
+    // image through parallel_for, which must call body(context, begin, end) so
+    // that every index in [0, count) is covered exactly once, on any threads
+    // and in any order, and return when all calls are done. NULL (the default)
+    // runs everything on the calling thread.
+    typedef void stbi_parallel_body(void *context, int begin, int end);
+    typedef void stbi_parallel_for(stbi_parallel_body *body, void *context, int count);
+    STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for);
+
+    // highest instruction set the JPEG decoder may use: 0 plain C, 1 SSE2 or
+    // NEON, 2 AVX2 (the default). Every level decodes to the same bytes, lower
+    // ones are there to check and time the others.
+    STBIDEF void stbi_set_jpeg_simd_level(int level);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -733,6 +748,42 @@ static int stbi__sse2_available()
 #endif
 #endif
 
+// AVX2 kernels for the JPEG decoder, used on top of SSE2 when the CPU has
+// them. They are compiled for AVX2 one function at a time, so the rest of
+// the file still runs on any SSE2 machine. Define STBI_NO_AVX2 to leave
+// them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && \
+    ((defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__) >= 409))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+
+static int stbi__avx2_available()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    __cpuid(info, 1);
+    // the OS has to save the ymm registers too
+    if (((info[2] >> 27) & 1) == 0 || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return ((info[1] >> 5) & 1) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+
+static int stbi__avx2_available()
+{
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1028,6 +1079,29 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static stbi_parallel_for *stbi__parallel_for = NULL;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for)
+{
+    stbi__parallel_for = parallel_for;
+}
+
+static int stbi__jpeg_simd_level = 2;
+
+STBIDEF void stbi_set_jpeg_simd_level(int level)
+{
+    stbi__jpeg_simd_level = level;
+}
+
+// runs body over [0, count) through the parallel-for hook, or right here without one
+static void stbi__run_parallel(stbi_parallel_body *body, void *context, int count)
+{
+    if (stbi__parallel_for && count > 1)
+        stbi__parallel_for(body, context, count);
+    else if (count > 0)
+        body(context, 0, count);
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1775,6 +1849,8 @@ typedef struct
 
     // kernels
     void(*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
+    // two horizontally adjacent blocks, data[64..127] the right one; NULL if there is none
+    void(*idct_block2_kernel)(stbi_uc *out, int out_stride, short data[128]);
     void(*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
     stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
@@ -2478,6 +2554,186 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT of two blocks at once: each 256-bit register holds the
+// same row of both blocks, one per 128-bit lane, and every step below stays
+// within its lane, so this is the sse2 version above run on two blocks. It
+// is just as bit-identical to the generic C version.
+STBI__AVX2_TARGET static void stbi__idct2_avx2(stbi_uc *out, int out_stride, short data[128])
+{
+    __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m256i tmp;
+
+#define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+#define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+#define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    // row r of the first block in the low lane, of the second in the high lane
+#define dct_load(r) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (data + (r) * 8))), \
+         _mm_loadu_si128((const __m128i *) (data + 64 + (r) * 8)), 1)
+
+    // the two blocks sit side by side in the output, so rows a and b of
+    // both are the even and odd 64-bit halves of p
+#define dct_store(p) \
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(_mm256_permute4x64_epi64((p), 0x08))); out += out_stride; \
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(_mm256_permute4x64_epi64((p), 0x0d))); out += out_stride
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    // load
+    row0 = dct_load(0);
+    row1 = dct_load(1);
+    row2 = dct_load(2);
+    row3 = dct_load(3);
+    row4 = dct_load(4);
+    row5 = dct_load(5);
+    row6 = dct_load(6);
+    row7 = dct_load(7);
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose pass 1
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        // transpose pass 2
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        // transpose pass 3
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack
+        __m256i p0 = _mm256_packus_epi16(row0, row1);
+        __m256i p1 = _mm256_packus_epi16(row2, row3);
+        __m256i p2 = _mm256_packus_epi16(row4, row5);
+        __m256i p3 = _mm256_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose pass 1
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        // transpose pass 2
+        dct_interleave8(p0, p1);
+        dct_interleave8(p2, p3);
+
+        // transpose pass 3
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        // store
+        dct_store(p0);
+        dct_store(p2);
+        dct_store(p1);
+        dct_store(p3);
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+#undef dct_store
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2855,21 +3111,47 @@ static void stbi__jpeg_dequantize(short *data, stbi_uc *dequant)
         data[i] *= dequant[i];
 }
 
+typedef struct
+{
+    stbi__jpeg *z;
+    int n;  // component
+} stbi__jpeg_finish_job;
+
+// dequantize and idct block rows [begin, end) of one component; every block
+// row owns its coefficients and output pixels, so rows can run in parallel
+static void stbi__jpeg_finish_rows(void *context, int begin, int end)
+{
+    stbi__jpeg_finish_job *job = (stbi__jpeg_finish_job *)context;
+    stbi__jpeg *z = job->z;
+    int n = job->n;
+    int i, j;
+    int w = (z->img_comp[n].x + 7) >> 3;
+    for (j = begin; j < end; ++j) {
+        for (i = 0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+            // coefficients of a block row are contiguous, so its blocks can go in pairs
+            if (z->idct_block2_kernel && i + 1 < w) {
+                stbi__jpeg_dequantize(data + 64, z->dequant[z->img_comp[n].tq]);
+                z->idct_block2_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+                ++i;
+                continue;
+            }
+            z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+        }
+    }
+}
+
 static void stbi__jpeg_finish(stbi__jpeg *z)
 {
     if (z->progressive) {
         // dequantize and idct the data
-        int i, j, n;
+        int n;
         for (n = 0; n < z->s->img_n; ++n) {
-            int w = (z->img_comp[n].x + 7) >> 3;
-            int h = (z->img_comp[n].y + 7) >> 3;
-            for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
-                    short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-                    stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
-                }
-            }
+            stbi__jpeg_finish_job job;
+            job.z = z;
+            job.n = n;
+            stbi__run_parallel(stbi__jpeg_finish_rows, &job, (z->img_comp[n].y + 7) >> 3);
         }
     }
 }
@@ -3561,15 +3843,194 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the sse2 upsampler above, 16 pixels at a time
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+    // need to generate 2x2 samples for every one in input
+    int i = 0, t0, t1;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    t1 = 3 * in_near[0] + in_far[0];
+    // process groups of 16 pixels for as long as we can.
+    // note we can't handle the last pixel in a row in this loop
+    // because we need to handle the filter boundary conditions.
+    for (; i < ((w - 1) & ~15); i += 16) {
+        // load and perform the vertical filtering pass
+        // this uses 3*x + y = 4*x + (y - x)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+        __m256i diff = _mm256_sub_epi16(farw, nearw);
+        __m256i nears = _mm256_slli_epi16(nearw, 2);
+        __m256i curr = _mm256_add_epi16(nears, diff); // current row
+
+        // "prev" and "next" are the current row shifted by one pixel; the
+        // byte shifts only work within a 128-bit lane, so the pixel that
+        // crosses the middle comes from a lane swapped copy of curr.
+        __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+        __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+        __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+        __m256i next = _mm256_insert_epi16(nxt0, 3 * in_near[i + 16] + in_far[i + 16], 15);
+
+        // horizontal filter, polyphase implementation since it's convenient:
+        // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+        // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+        // note the shared term.
+        __m256i bias = _mm256_set1_epi16(8);
+        __m256i curs = _mm256_slli_epi16(curr, 2);
+        __m256i prvd = _mm256_sub_epi16(prev, curr);
+        __m256i nxtd = _mm256_sub_epi16(next, curr);
+        __m256i curb = _mm256_add_epi16(curs, bias);
+        __m256i even = _mm256_add_epi16(prvd, curb);
+        __m256i odd = _mm256_add_epi16(nxtd, curb);
+
+        // interleave even and odd pixels, then undo scaling. each lane ends
+        // up holding its own 8 input pixels, so the pack comes out in order.
+        __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+        __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+        __m256i de0 = _mm256_srli_epi16(int0, 4);
+        __m256i de1 = _mm256_srli_epi16(int1, 4);
+
+        // pack and write output
+        __m256i outv = _mm256_packus_epi16(de0, de1);
+        _mm256_storeu_si256((__m256i *) (out + i * 2), outv);
+
+        // "previous" value for next iter
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i) {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+
+#ifndef STBI_JPEG_OLD
+// the sse2 color conversion above, 16 pixels at a time, and for step == 3
+// as well: a byte shuffle drops the alpha channel from every 4 pixels.
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+    int i = 0;
+
+    if (step == 3 || step == 4) {
+        __m128i signflip = _mm_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f*4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f*4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f*4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f*4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+        __m128i rgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        for (; i + 15 < count; i += 16) {
+            // load
+            __m128i y_bytes = _mm_loadu_si128((__m128i *) (y + i));
+            __m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr + i)), signflip); // -128
+            __m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb + i)), signflip); // -128
+
+            // widen to short (and left-shift cr, cb by 8), as the sse2 unpack does
+            __m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+            __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+            __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte, set up for transpose
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+            // transpose to interleave channels; the low lane gets pixels
+            // 0-3 and 4-7, the high lane 8-11 and 12-15
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // store
+            if (step == 4) {
+                _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+                _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+                out += 64;
+            }
+            else {
+                // each 16 byte store leaves 4 junk bytes that the next one
+                // overwrites; the last one stops at the final pixel
+                __m128i p3 = _mm_shuffle_epi8(_mm256_extracti128_si256(o1, 1), rgb);
+                int tail;
+                _mm_storeu_si128((__m128i *) (out + 0), _mm_shuffle_epi8(_mm256_castsi256_si128(o0), rgb));
+                _mm_storeu_si128((__m128i *) (out + 12), _mm_shuffle_epi8(_mm256_castsi256_si128(o1), rgb));
+                _mm_storeu_si128((__m128i *) (out + 24), _mm_shuffle_epi8(_mm256_extracti128_si256(o0, 1), rgb));
+                _mm_storel_epi64((__m128i *) (out + 36), p3);
+                tail = _mm_cvtsi128_si32(_mm_srli_si128(p3, 8));
+                memcpy(out + 44, &tail, 4);
+                out += 48;
+            }
+        }
+    }
+
+    for (; i < count; ++i) {
+        int y_fixed = (y[i] << 20) + (1 << 19); // rounding
+        int r, g, b;
+        int cr = pcr[i] - 128;
+        int cb = pcb[i] - 128;
+        r = y_fixed + cr* float2fixed(1.40200f);
+        g = y_fixed + cr*-float2fixed(0.71414f) + ((cb*-float2fixed(0.34414f)) & 0xffff0000);
+        b = y_fixed + cb* float2fixed(1.77200f);
+        r >>= 20;
+        g >>= 20;
+        b >>= 20;
+        if ((unsigned)r > 255) { if (r < 0) r = 0; else r = 255; }
+        if ((unsigned)g > 255) { if (g < 0) g = 0; else g = 255; }
+        if ((unsigned)b > 255) { if (b < 0) b = 0; else b = 255; }
+        out[0] = (stbi_uc)r;
+        out[1] = (stbi_uc)g;
+        out[2] = (stbi_uc)b;
+        out[3] = 255;
+        out += step;
+    }
+}
+#endif
+#endif // STBI_AVX2
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
     j->idct_block_kernel = stbi__idct_block;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
     j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+    j->idct_block2_kernel = NULL;
 
 #ifdef STBI_SSE2
-    if (stbi__sse2_available()) {
+    if (stbi__jpeg_simd_level >= 1 && stbi__sse2_available()) {
         j->idct_block_kernel = stbi__idct_simd;
 #ifndef STBI_JPEG_OLD
         j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3578,12 +4039,24 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
     }
 #endif
 
+#ifdef STBI_AVX2
+    if (stbi__jpeg_simd_level >= 2 && stbi__sse2_available() && stbi__avx2_available()) {
+        j->idct_block2_kernel = stbi__idct2_avx2;
+#ifndef STBI_JPEG_OLD
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+#endif
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+    }
+#endif
+
 #ifdef STBI_NEON
-    j->idct_block_kernel = stbi__idct_simd;
+    if (stbi__jpeg_simd_level >= 1) {
+        j->idct_block_kernel = stbi__idct_simd;
 #ifndef STBI_JPEG_OLD
-    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
 #endif
-    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+    }
 #endif
 }
 
@@ -3603,6 +4076,127 @@ typedef struct
     int ypos;    // which pre-expansion row we're on
 } stbi__resample;
 
+// output rows per unit of work when color conversion runs in parallel
+#define STBI__JPEG_CONVERT_ROWS 16
+
+// resample and color-convert output rows [j0, j1) into output, using
+// linebuf[k] as the upsampling scratch row of component k. The converters
+// write a 4th byte after the last pixel even when n is 3, which would land
+// in row j1; with last_row set (n * img_x + 1 bytes), row j1 - 1 is built
+// there and copied over instead.
+static void stbi__jpeg_convert_rows(stbi__jpeg *z, const stbi__resample *res_setup, stbi_uc **linebuf,
+    stbi_uc *last_row, stbi_uc *output, int n, int decode_n, unsigned int j0, unsigned int j1)
+{
+    int k;
+    unsigned int i, j;
+    stbi_uc *coutput[4];
+    stbi__resample res_comp[4];
+
+    // place each resampler at row j0: it moves on to the next pre-expansion
+    // row every vs output rows, starting half way through the first
+    for (k = 0; k < decode_n; ++k) {
+        stbi__resample *r = &res_comp[k];
+        int steps = (res_setup[k].vs >> 1) + (int)j0;
+        int last = z->img_comp[k].y - 1;
+        int rows = steps / res_setup[k].vs;
+        *r = res_setup[k];
+        r->ystep = steps % r->vs;
+        r->ypos = rows;
+        r->line1 = z->img_comp[k].data + z->img_comp[k].w2 * (rows < last ? rows : last);
+        r->line0 = rows > 0 ? z->img_comp[k].data + z->img_comp[k].w2 * (rows - 1 < last ? rows - 1 : last) : r->line1;
+    }
+
+    for (j = j0; j < j1; ++j) {
+        stbi_uc *row = last_row && j + 1 == j1 ? last_row : output + n * z->s->img_x * j;
+        stbi_uc *out = row;
+        for (k = 0; k < decode_n; ++k) {
+            stbi__resample *r = &res_comp[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                y_bot ? r->line1 : r->line0,
+                y_bot ? r->line0 : r->line1,
+                r->w_lores, r->hs);
+            if (++r->ystep >= r->vs) {
+                r->ystep = 0;
+                r->line0 = r->line1;
+                if (++r->ypos < z->img_comp[k].y)
+                    r->line1 += z->img_comp[k].w2;
+            }
+        }
+        if (n >= 3) {
+            stbi_uc *y = coutput[0];
+            if (z->s->img_n == 3) {
+                if (z->rgb == 3) {
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+                for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+                for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+        }
+        if (row == last_row)
+            memcpy(output + n * z->s->img_x * j, last_row, n * z->s->img_x);
+    }
+}
+
+typedef struct
+{
+    stbi__jpeg *z;
+    const stbi__resample *res_setup;
+    stbi_uc *output;
+    int n, decode_n;
+    stbi_uc *failed;    // per unit of work, set if its line buffers could not be allocated
+} stbi__jpeg_convert_job;
+
+// converts units [begin, end) of STBI__JPEG_CONVERT_ROWS rows each, with
+// line buffers of its own so it can run next to the other units
+static void stbi__jpeg_convert_units(void *context, int begin, int end)
+{
+    stbi__jpeg_convert_job *job = (stbi__jpeg_convert_job *)context;
+    stbi__jpeg *z = job->z;
+    stbi_uc *linebuf[4];
+    stbi_uc *last_row;
+    unsigned int j0 = (unsigned int)begin * STBI__JPEG_CONVERT_ROWS;
+    unsigned int j1 = (unsigned int)end * STBI__JPEG_CONVERT_ROWS;
+    int k, unit;
+
+    // line buffers, then a row for the last one before another unit's rows
+    linebuf[0] = (stbi_uc *)stbi__malloc_mad2(job->decode_n, z->s->img_x + 3, job->n * z->s->img_x + 1);
+    if (!linebuf[0]) {
+        for (unit = begin; unit < end; ++unit) job->failed[unit] = 1;
+        return;
+    }
+    for (k = 1; k < job->decode_n; ++k)
+        linebuf[k] = linebuf[k - 1] + z->s->img_x + 3;
+    last_row = linebuf[0] + job->decode_n * (z->s->img_x + 3);
+    if (j1 >= z->s->img_y) {
+        // the output buffer has a spare byte after the last row
+        j1 = z->s->img_y;
+        last_row = NULL;
+    }
+    stbi__jpeg_convert_rows(z, job->res_setup, linebuf, last_row, job->output, job->n, job->decode_n, j0, j1);
+    STBI_FREE(linebuf[0]);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
     int n, decode_n;
@@ -3625,9 +4219,9 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
     // resample and color-convert
     {
         int k;
-        unsigned int i, j;
         stbi_uc *output;
-        stbi_uc *coutput[4];
+        stbi_uc *linebuf[4];
+        int units;
 
         stbi__resample res_comp[4];
 
@@ -3638,6 +4232,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
             // with upsample factor of 4
             z->img_comp[k].linebuf = (stbi_uc *)stbi__malloc(z->s->img_x + 3);
             if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+            linebuf[k] = z->img_comp[k].linebuf;
 
             r->hs = z->img_h_max / z->img_comp[k].h;
             r->vs = z->img_v_max / z->img_comp[k].v;
@@ -3653,57 +4248,32 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
             else                               r->resample = stbi__resample_row_generic;
         }
 
-        // can't error after this so, this is safe
+        // the serial path can't error after this
         output = (stbi_uc *)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-        // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j) {
-            stbi_uc *out = output + n * z->s->img_x * j;
-            for (k = 0; k < decode_n; ++k) {
-                stbi__resample *r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                    y_bot ? r->line1 : r->line0,
-                    y_bot ? r->line0 : r->line1,
-                    r->w_lores, r->hs);
-                if (++r->ystep >= r->vs) {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
-            }
-            if (n >= 3) {
-                stbi_uc *y = coutput[0];
-                if (z->s->img_n == 3) {
-                    if (z->rgb == 3) {
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
-            }
-            else {
-                stbi_uc *y = coutput[0];
-                if (n == 1)
-                    for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-                else
-                    for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-            }
+        // now go ahead and resample; every row depends only on the decoded
+        // components, so with a parallel-for hook bands of rows run at once
+        units = (int)((z->s->img_y + STBI__JPEG_CONVERT_ROWS - 1) / STBI__JPEG_CONVERT_ROWS);
+        if (stbi__parallel_for && units > 1) {
+            stbi__jpeg_convert_job job;
+            int unit, failed = 0;
+            job.z = z;
+            job.res_setup = res_comp;
+            job.output = output;
+            job.n = n;
+            job.decode_n = decode_n;
+            job.failed = (stbi_uc *)stbi__malloc(units);
+            if (!job.failed) { STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+            memset(job.failed, 0, units);
+            stbi__run_parallel(stbi__jpeg_convert_units, &job, units);
+            for (unit = 0; unit < units; ++unit)
+                failed |= job.failed[unit];
+            STBI_FREE(job.failed);
+            if (failed) { STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+        }
+        else {
+            stbi__jpeg_convert_rows(z, res_comp, linebuf, NULL, output, n, decode_n, 0, z->s->img_y);
         }
         stbi__cleanup_jpeg(z);
         *out_x = z->s->img_x;